@@ -2,8 +2,10 @@
 
 #include <boost/core/demangle.hpp>  // for demangling
 #include <limits>
+#include <memory>
 #include <optional>
 #include <string>
+#include <utility>
 
 #include "hdtree/ClassVersion.h"
 #include "hdtree/Version.h"
@@ -44,6 +46,15 @@ class BaseBranch {
 
   virtual void load() = 0;
 
+  /**
+   * pure virtual method for moving to an entry in the input file
+   *
+   * After seeking, the next call to load reads the input entry.
+   *
+   * @param[in] i_entry entry to move to
+   */
+  virtual void seek(std::size_t i_entry) = 0;
+
   /**
    * we should persist our hierarchy
    * into the output file
@@ -64,6 +75,42 @@ class BaseBranch {
    */
   virtual void clear() = 0;
 
+  /**
+   * Get the full name of this branch
+   * @return name of branch
+   */
+  const std::string& name() const { return name_; }
+
+  /**
+   * pure virtual method for making a new branch of the same type and name
+   *
+   * The new branch is not attached to any files, so it only holds
+   * an in-memory object that can be exchanged with ours.
+   *
+   * @return new branch holding the same type of data
+   */
+  virtual std::unique_ptr<BaseBranch> sprout() const = 0;
+
+  /**
+   * pure virtual method for copying the in-memory data of another branch
+   *
+   * @note The other branch must be holding the same type of data,
+   * i.e. it was sprouted from us or we were sprouted from it.
+   *
+   * @param[in] other branch to copy the data of
+   */
+  virtual void copy_from(const BaseBranch& other) = 0;
+
+  /**
+   * pure virtual method for exchanging in-memory data with another branch
+   *
+   * @note The other branch must be holding the same type of data,
+   * i.e. it was sprouted from us or we were sprouted from it.
+   *
+   * @param[in,out] other branch to exchange data with
+   */
+  virtual void swap(BaseBranch& other) = 0;
+
   /// no copying
   BaseBranch(const BaseBranch&) = delete;
   /// no copying
@@ -107,7 +154,7 @@ class AbstractBranch : public BaseBranch {
                           DataType* handle = nullptr)
       : BaseBranch(branch_name), owner_{handle == nullptr} {
     if (owner_) {
-      handle_ = new DataType;
+      handle_ = new DataType{};
     } else {
       handle_ = handle;
     }
@@ -178,6 +225,35 @@ class AbstractBranch : public BaseBranch {
     }
   }
 
+  /**
+   * Make a new branch of the same type and name
+   *
+   * This is defined in Branch.h after all of the specializations
+   * of Branch have been declared.
+   *
+   * @return new detached branch
+   */
+  virtual std::unique_ptr<BaseBranch> sprout() const override;
+
+  /**
+   * Copy the in-memory data of another branch holding the same type
+   *
+   * @param[in] other branch to copy the data of
+   */
+  void copy_from(const BaseBranch& other) final override {
+    this->update(static_cast<const AbstractBranch<DataType>&>(other).get());
+  }
+
+  /**
+   * Exchange the in-memory data with another branch holding the same type
+   *
+   * @param[in,out] other branch to exchange data with
+   */
+  void swap(BaseBranch& other) final override {
+    using std::swap;
+    swap(*handle_, *static_cast<AbstractBranch<DataType>&>(other).handle_);
+  }
+
   /**
    * Get the current in-memory data.
    *
@@ -0,0 +1,399 @@
+/**
+ * @file Aggregate.h
+ * Definition of the summaries and histograms filled from whole columns
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "hdtree/Exception.h"
+
+namespace hdtree {
+
+/**
+ * Number of independent accumulators used by the kernels
+ *
+ * Floating-point addition is not associative, so the compiler is not
+ * allowed to vectorize a single running sum. Keeping this many
+ * separate sums that are only combined at the end lets it put them
+ * into vector registers instead.
+ */
+constexpr std::size_t AGGREGATE_LANES = 8;
+
+/**
+ * The summary statistics of the values of a branch
+ *
+ * ```cpp
+ * hdtree::Summary s = tree.reduce<double>("energy");
+ * std::cout << s.mean() << " +- " << std::sqrt(s.variance()) << std::endl;
+ * ```
+ *
+ * Weighted fills weight the sums but not the count, min, or max.
+ */
+struct Summary {
+  /// number of values filled
+  std::size_t count{0};
+  /// sum of the weights of the values
+  double sum_weights{0.};
+  /// weighted sum of the values
+  double sum{0.};
+  /// weighted sum of the squares of the values
+  double sum2{0.};
+  /// smallest value filled
+  double min{std::numeric_limits<double>::infinity()};
+  /// largest value filled
+  double max{-std::numeric_limits<double>::infinity()};
+
+  /**
+   * The weighted mean of the values
+   * @return mean, NaN if nothing has been filled
+   */
+  double mean() const {
+    return sum_weights != 0. ? sum / sum_weights
+                             : std::numeric_limits<double>::quiet_NaN();
+  }
+
+  /**
+   * The weighted (population) variance of the values
+   * @return variance, NaN if nothing has been filled
+   */
+  double variance() const {
+    double m = mean();
+    return sum2 / sum_weights - m * m;
+  }
+
+  /**
+   * Fill a run of values
+   *
+   * The sums are kept in AGGREGATE_LANES lanes so the loop vectorizes.
+   *
+   * @tparam T arithmetic type of the values
+   * @param[in] x pointer to the values
+   * @param[in] w pointer to the weight of each value,
+   * nullptr to weight every value by one
+   * @param[in] n number of values
+   */
+  template <typename T>
+  void fill(const T* x, const double* w, std::size_t n) {
+    constexpr std::size_t L{AGGREGATE_LANES};
+    double sw[L]{}, s[L]{}, s2[L]{}, lo[L], hi[L];
+    std::fill(lo, lo + L, min);
+    std::fill(hi, hi + L, max);
+    std::size_t n_full{n - n % L};
+    if (w) {
+      for (std::size_t i{0}; i < n_full; i += L) {
+        for (std::size_t l{0}; l < L; l++) {
+          double v = x[i + l];
+          sw[l] += w[i + l];
+          s[l] += w[i + l] * v;
+          s2[l] += w[i + l] * v * v;
+          lo[l] = v < lo[l] ? v : lo[l];
+          hi[l] = v > hi[l] ? v : hi[l];
+        }
+      }
+      for (std::size_t i{n_full}; i < n; i++) {
+        double v = x[i];
+        sw[0] += w[i];
+        s[0] += w[i] * v;
+        s2[0] += w[i] * v * v;
+        lo[0] = v < lo[0] ? v : lo[0];
+        hi[0] = v > hi[0] ? v : hi[0];
+      }
+    } else {
+      for (std::size_t i{0}; i < n_full; i += L) {
+        for (std::size_t l{0}; l < L; l++) {
+          double v = x[i + l];
+          s[l] += v;
+          s2[l] += v * v;
+          lo[l] = v < lo[l] ? v : lo[l];
+          hi[l] = v > hi[l] ? v : hi[l];
+        }
+      }
+      for (std::size_t i{n_full}; i < n; i++) {
+        double v = x[i];
+        s[0] += v;
+        s2[0] += v * v;
+        lo[0] = v < lo[0] ? v : lo[0];
+        hi[0] = v > hi[0] ? v : hi[0];
+      }
+      sw[0] += n;
+    }
+    count += n;
+    for (std::size_t l{0}; l < L; l++) {
+      sum_weights += sw[l];
+      sum += s[l];
+      sum2 += s2[l];
+      min = std::min(min, lo[l]);
+      max = std::max(max, hi[l]);
+    }
+  }
+
+  /**
+   * Add the values summarized by another summary into this one
+   * @param[in] other summary to merge in
+   * @return reference to this summary
+   */
+  Summary& operator+=(const Summary& other) {
+    count += other.count;
+    sum_weights += other.sum_weights;
+    sum += other.sum;
+    sum2 += other.sum2;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    return *this;
+  }
+};
+
+/**
+ * The uniform binning of one axis of a histogram
+ *
+ * Bin 0 is the underflow and bin n_bins+1 is the overflow,
+ * NaN values are put into the underflow.
+ */
+class Axis {
+ public:
+  /**
+   * Define the binning
+   *
+   * @throws HDTreeException if there are no bins or the range is empty
+   *
+   * @param[in] n_bins number of bins between low and high
+   * @param[in] low lower edge of the first bin
+   * @param[in] high upper edge of the last bin
+   */
+  Axis(std::size_t n_bins, double low, double high)
+      : n_bins_{n_bins},
+        low_{low},
+        high_{high},
+        scale_{n_bins / (high - low)} {
+    if (n_bins == 0 or not(high > low)) {
+      throw HDTreeException(
+          "Histogram axis with " + std::to_string(n_bins) + " bins from " +
+              std::to_string(low) + " to " + std::to_string(high) +
+              " has no bins.",
+          "An axis needs at least one bin and its upper edge needs to be "
+          "above its lower edge.");
+    }
+  }
+
+  /// number of bins not counting the underflow and overflow
+  std::size_t n_bins() const { return n_bins_; }
+  /// lower edge of the first bin
+  double low() const { return low_; }
+  /// upper edge of the last bin
+  double high() const { return high_; }
+
+  /**
+   * The lower edge of a bin
+   * @param[in] i_bin index of bin, 1 is the first bin
+   * @return lower edge of the bin
+   */
+  double edge(std::size_t i_bin) const {
+    return low_ + (i_bin - 1.) * (high_ - low_) / n_bins_;
+  }
+
+  /**
+   * Find the bin a value falls into
+   *
+   * This is branch-free so it vectorizes when called in a loop.
+   *
+   * @param[in] x value to bin
+   * @return index of bin including the underflow and overflow
+   */
+  std::size_t index(double x) const {
+    double b = (x - low_) * scale_;
+    return not(b >= 0.) ? 0
+           : b >= n_bins_ ? n_bins_ + 1
+                          : static_cast<std::size_t>(b) + 1;
+  }
+
+  /// is this the same binning as the other axis?
+  bool operator==(const Axis& other) const {
+    return n_bins_ == other.n_bins_ and low_ == other.low_ and
+           high_ == other.high_;
+  }
+
+ private:
+  /// number of bins
+  std::size_t n_bins_;
+  /// lower edge of the first bin
+  double low_;
+  /// upper edge of the last bin
+  double high_;
+  /// number of bins per unit of the axis
+  double scale_;
+};
+
+/**
+ * A histogram with uniform bins in one or two dimensions
+ *
+ * The sum of the weights and the sum of the squares of the weights
+ * are kept for each bin (including the underflow and overflow) so
+ * the statistical uncertainty of each bin is sqrt(sum_w2).
+ *
+ * ```cpp
+ * hdtree::Histogram h = tree.histogram<double>(
+ *     "energy", hdtree::Axis(100, 0., 10.));
+ * for (std::size_t i{1}; i <= h.x().n_bins(); i++) {
+ *   std::cout << h.x().edge(i) << " " << h.at(i) << std::endl;
+ * }
+ * ```
+ */
+class Histogram {
+ public:
+  /**
+   * Define a 1D histogram
+   * @param[in] x binning of the axis
+   */
+  explicit Histogram(const Axis& x) : Histogram(x, Axis(1, 0., 1.), false) {}
+
+  /**
+   * Define a 2D histogram
+   * @param[in] x binning of the first axis
+   * @param[in] y binning of the second axis
+   */
+  Histogram(const Axis& x, const Axis& y) : Histogram(x, y, true) {}
+
+  /// number of dimensions of this histogram
+  std::size_t dimensions() const { return two_d_ ? 2 : 1; }
+  /// binning of the first axis
+  const Axis& x() const { return x_; }
+  /// binning of the second axis
+  const Axis& y() const { return y_; }
+
+  /**
+   * The sum of weights in a bin
+   * @param[in] ix index of bin along the first axis
+   * @param[in] iy index of bin along the second axis (2D only)
+   * @return sum of weights in the bin
+   */
+  double at(std::size_t ix, std::size_t iy = 0) const {
+    return sum_w_.at(flat(ix, iy));
+  }
+
+  /**
+   * The sum of the squared weights in a bin
+   * @param[in] ix index of bin along the first axis
+   * @param[in] iy index of bin along the second axis (2D only)
+   * @return sum of squared weights in the bin
+   */
+  double sum_w2(std::size_t ix, std::size_t iy = 0) const {
+    return sum_w2_.at(flat(ix, iy));
+  }
+
+  /**
+   * The sums of the weights of all bins
+   *
+   * The bins are ordered with the first axis varying fastest.
+   *
+   * @return sum of weights in each bin
+   */
+  const std::vector<double>& sum_w() const { return sum_w_; }
+
+  /**
+   * Fill a run of values
+   *
+   * The bin indices are found in blocks with a loop that vectorizes
+   * before the weights are added to the bins.
+   *
+   * @tparam T arithmetic type of the values
+   * @param[in] x pointer to the values along the first axis
+   * @param[in] y pointer to the values along the second axis,
+   * ignored (and may be nullptr) for 1D histograms
+   * @param[in] w pointer to the weight of each value,
+   * nullptr to weight every value by one
+   * @param[in] n number of values
+   */
+  template <typename T>
+  void fill(const T* x, const T* y, const double* w, std::size_t n) {
+    constexpr std::size_t block{256};
+    std::size_t idx[block];
+    const std::size_t stride{x_.n_bins() + 2};
+    for (std::size_t start{0}; start < n; start += block) {
+      std::size_t m = std::min(block, n - start);
+      for (std::size_t i{0}; i < m; i++) {
+        idx[i] = x_.index(x[start + i]);
+      }
+      if (two_d_) {
+        for (std::size_t i{0}; i < m; i++) {
+          idx[i] += stride * y_.index(y[start + i]);
+        }
+      }
+      if (w) {
+        for (std::size_t i{0}; i < m; i++) {
+          sum_w_[idx[i]] += w[start + i];
+          sum_w2_[idx[i]] += w[start + i] * w[start + i];
+        }
+      } else {
+        for (std::size_t i{0}; i < m; i++) {
+          sum_w_[idx[i]] += 1.;
+          sum_w2_[idx[i]] += 1.;
+        }
+      }
+    }
+  }
+
+  /**
+   * Add the bins of another histogram into this one
+   *
+   * @throws HDTreeException if the histograms are binned differently
+   *
+   * @param[in] other histogram to merge in
+   * @return reference to this histogram
+   */
+  Histogram& operator+=(const Histogram& other) {
+    if (two_d_ != other.two_d_ or not(x_ == other.x_) or
+        not(y_ == other.y_)) {
+      throw HDTreeException(
+          "Attempting to add histograms with different binning.",
+          "Only histograms defined with the same axes can be added.");
+    }
+    for (std::size_t i{0}; i < sum_w_.size(); i++) {
+      sum_w_[i] += other.sum_w_[i];
+      sum_w2_[i] += other.sum_w2_[i];
+    }
+    return *this;
+  }
+
+ private:
+  /**
+   * Define the histogram and allocate its bins
+   * @param[in] x binning of the first axis
+   * @param[in] y binning of the second axis
+   * @param[in] two_d true if the second axis is used
+   */
+  Histogram(const Axis& x, const Axis& y, bool two_d)
+      : x_{x},
+        y_{y},
+        two_d_{two_d},
+        sum_w_((x.n_bins() + 2) * (two_d ? y.n_bins() + 2 : 1), 0.),
+        sum_w2_(sum_w_.size(), 0.) {}
+
+  /**
+   * Index of a bin in the flattened bins
+   * @param[in] ix index of bin along the first axis
+   * @param[in] iy index of bin along the second axis
+   * @return index into the sums
+   */
+  std::size_t flat(std::size_t ix, std::size_t iy) const {
+    return ix + (x_.n_bins() + 2) * iy;
+  }
+
+ private:
+  /// binning of the first axis
+  Axis x_;
+  /// binning of the second axis
+  Axis y_;
+  /// true if this is a 2D histogram
+  bool two_d_;
+  /// sum of the weights in each bin
+  std::vector<double> sum_w_;
+  /// sum of the squared weights in each bin
+  std::vector<double> sum_w2_;
+};
+
+}  // namespace hdtree
@@ -11,6 +11,8 @@
 #undef FALSE
 #endif
 
+#include <cstddef>
+#include <cstdint>
 #include <highfive/H5DataType.hpp>
 #include <type_traits>
 
@@ -46,6 +48,50 @@ enum class Bool : bool { TRUE = true, FALSE = false };
  */
 HighFive::EnumType<Bool> create_enum_bool();
 
+/**
+ * Version of bool data sets that are packed eight bools to a byte
+ *
+ * The default bool data sets use the h5py-compatible enum above and
+ * have version 0. Packed bool data sets are instead unsigned bytes
+ * with an attribute holding the number of bools they contain.
+ */
+inline constexpr int PACKED_BOOL_VERSION{1};
+
+/**
+ * Version of string branches that are stored in the flat layout
+ *
+ * The default string data sets use HDF5's variable-length strings
+ * and have version 0. Flat strings are instead a group like a
+ * vector holding the length of each string and all of the bytes
+ * of the strings one after the other.
+ */
+inline constexpr int FLAT_STRING_VERSION{1};
+
+/**
+ * Pack bools into bytes
+ *
+ * The i'th bool is put into bit (i % 8) of byte (i / 8), the same
+ * bit order as `numpy.packbits(..., bitorder='little')`, and any
+ * unused bits in the last byte are zero. The bytes are assumed
+ * to have space for (n + 7) / 8 bytes.
+ *
+ * @param[in] bools pointer to the bools to pack
+ * @param[in] n number of bools to pack
+ * @param[out] bytes pointer to write the packed bytes to
+ */
+void pack_bools(const Bool* bools, std::size_t n, std::uint8_t* bytes);
+
+/**
+ * Unpack bools from bytes
+ *
+ * @see pack_bools for the layout of the bits
+ *
+ * @param[in] bytes pointer to the packed bytes
+ * @param[in] n number of bools to unpack
+ * @param[out] bools pointer to write the n bools to
+ */
+void unpack_bools(const std::uint8_t* bytes, std::size_t n, Bool* bools);
+
 }  // namespace hdtree
 
 /**
@@ -0,0 +1,221 @@
+/**
+ * @file Batch.h
+ * Definition of the values of a branch for a batch of entries
+ */
+#pragma once
+
+#include "hdtree/Branch.h"
+#include "hdtree/View.h"
+
+namespace hdtree {
+
+/**
+ * The values of one branch for a batch of consecutive entries
+ *
+ * For atomic branches, there is one value per entry stored contiguously
+ * so the values can be passed directly to vectorized code.
+ *
+ * For vector branches, the content of all of the entries is stored
+ * contiguously and the offsets give where each entry's content begins
+ * (structure of arrays). The content of entry i is
+ * [offsets()[i], offsets()[i+1]).
+ *
+ * ```cpp
+ * auto& energy = tree.get_batch<double>("energy");
+ * auto& hits = tree.get_batch<double>("hit_energies");
+ * tree.for_each_batch(4096, [&](const hdtree::EntryRange& entries) {
+ *   for (std::size_t i{0}; i < energy.size(); i++) {
+ *     // energy[i] is the energy of entry entries.begin + i
+ *     // hits.entry(i) is a view of the hit energies of that entry
+ *   }
+ * });
+ * ```
+ *
+ * @note The values are only valid until the next batch is loaded.
+ *
+ * @tparam T arithmetic type of the values
+ */
+template <typename T>
+class Batch {
+ public:
+  /// an empty batch
+  Batch() = default;
+
+  /**
+   * Create a batch from its values and offsets
+   * @param[in] values all of the values in the batch
+   * @param[in] offsets offsets of each entry into the values,
+   * empty for atomic branches
+   */
+  Batch(View<T> values, View<std::size_t> offsets)
+      : values_{values}, offsets_{offsets} {}
+
+  /**
+   * Number of entries in this batch
+   * @return number of entries
+   */
+  std::size_t size() const {
+    return jagged() ? offsets_.size() - 1 : values_.size();
+  }
+
+  /**
+   * Are the values the content of vectors?
+   * @return true if we were loaded from a vector branch
+   */
+  bool jagged() const { return not offsets_.empty(); }
+
+  /**
+   * All of the values in this batch
+   * @return view of the values of all entries
+   */
+  const View<T>& values() const { return values_; }
+
+  /**
+   * Offsets of each entry into the values
+   * @return view of size()+1 offsets, empty if not jagged
+   */
+  const View<std::size_t>& offsets() const { return offsets_; }
+
+  /**
+   * The value of the i'th entry of an atomic branch
+   * @param[in] i index of entry within this batch
+   * @return value of entry
+   */
+  const T& operator[](std::size_t i) const { return values_[i]; }
+
+  /**
+   * The content of the i'th entry of a vector branch
+   * @param[in] i index of entry within this batch
+   * @return view of the content of the entry
+   */
+  View<T> entry(std::size_t i) const {
+    return View<T>(values_.data() + offsets_[i],
+                   offsets_[i + 1] - offsets_[i]);
+  }
+
+ private:
+  /// the values of all entries
+  View<T> values_;
+  /// offsets of each entry into the values (if jagged)
+  View<std::size_t> offsets_;
+};
+
+/**
+ * Type-less base for loading the batches of a branch
+ *
+ * @note Users should never interact with this class.
+ */
+class BaseBatchLoader {
+ public:
+  /// virtual destructor so the loaders can be properly destructed
+  virtual ~BaseBatchLoader() = default;
+  /**
+   * Load the next batch of entries
+   * @param[in] n number of entries in the batch
+   */
+  virtual void load(std::size_t n) = 0;
+  /**
+   * Move to the input entry
+   * @param[in] i_entry entry the next batch should start at
+   */
+  virtual void seek(std::size_t i_entry) = 0;
+};
+
+/**
+ * Loading the batches of an atomic or vector branch
+ *
+ * We hold the same atomic branches that Branch<T> or
+ * Branch<std::vector<T>> would and point the batch directly into
+ * their read buffers. If a batch spans a refill of a read buffer,
+ * the values are copied into a scratch buffer that we own instead.
+ *
+ * @tparam T arithmetic type of the values
+ */
+template <typename T>
+class BatchLoader : public BaseBatchLoader {
+  static_assert(std::is_arithmetic_v<T> and not std::is_same_v<T, bool>,
+                "Batches are only available for arithmetic types but bool.");
+
+ public:
+  /**
+   * Attach to the branch in the input file
+   *
+   * Vector branches are groups holding the size and content data sets.
+   *
+   * @param[in] branch_name name of the branch to load
+   * @param[in] f reader to load from
+   */
+  BatchLoader(const std::string& branch_name, Reader& f) {
+    if (f.getH5ObjectType(branch_name) == HighFive::ObjectType::Group) {
+      size_ = std::make_unique<Branch<std::size_t>>(branch_name + "/" +
+                                                    constants::SIZE_NAME);
+      size_->attach(f);
+      data_ = std::make_unique<Branch<T>>(branch_name + "/data");
+    } else {
+      data_ = std::make_unique<Branch<T>>(branch_name);
+    }
+    data_->attach(f);
+  }
+
+  /**
+   * Load the next batch of entries
+   *
+   * For vector branches, we view the next n sizes and sum them up
+   * into the offsets before viewing that much content.
+   *
+   * @param[in] n number of entries in the batch
+   */
+  void load(std::size_t n) final override {
+    if (size_) {
+      const std::size_t* sizes = size_->view(n, size_scratch_);
+      offsets_.resize(n + 1);
+      offsets_[0] = 0;
+      for (std::size_t i{0}; i < n; i++) {
+        offsets_[i + 1] = offsets_[i] + sizes[i];
+      }
+      std::size_t n_values = offsets_[n];
+      batch_ = Batch<T>(View<T>(data_->view(n_values, scratch_), n_values),
+                        View<std::size_t>(offsets_.data(), n + 1));
+    } else {
+      batch_ = Batch<T>(View<T>(data_->view(n, scratch_), n), {});
+    }
+  }
+
+  /**
+   * Move to the input entry
+   *
+   * @see Branch<std::vector<T>>::seek
+   *
+   * @param[in] i_entry entry the next batch should start at
+   */
+  void seek(std::size_t i_entry) final override {
+    if (size_) {
+      data_->seek(size_->sum_before(i_entry));
+      size_->seek(i_entry);
+    } else {
+      data_->seek(i_entry);
+    }
+  }
+
+  /**
+   * Get the batch we last loaded
+   * @return the batch
+   */
+  const Batch<T>& batch() const { return batch_; }
+
+ private:
+  /// the sizes of the vectors, nullptr if an atomic branch
+  std::unique_ptr<Branch<std::size_t>> size_;
+  /// the values of the entries or the content of the vectors
+  std::unique_ptr<Branch<T>> data_;
+  /// the batch we last loaded
+  Batch<T> batch_;
+  /// offsets of each entry into the content
+  std::vector<std::size_t> offsets_;
+  /// copy of the values when they span a buffer refill
+  std::vector<T> scratch_;
+  /// copy of the sizes when they span a buffer refill
+  std::vector<std::size_t> size_scratch_;
+};
+
+}  // namespace hdtree
@@ -6,9 +6,12 @@
  */
 #pragma once
 
+#include <cmath>
 #include <exception>
+#include <limits>
 #include <map>
 #include <memory>
+#include <numeric>
 #include <type_traits>
 #include <vector>
 
@@ -24,5 +27,16 @@
 
 // the other template specializations of Branch
 #include "hdtree/branch/AtomicBranch.h"
+#include "hdtree/branch/CategoricalBranch.h"
 #include "hdtree/branch/MapBranch.h"
 #include "hdtree/branch/VectorBranch.h"
+#include "hdtree/branch/ViewBranch.h"
+
+namespace hdtree {
+
+template <typename DataType>
+std::unique_ptr<BaseBranch> AbstractBranch<DataType>::sprout() const {
+  return std::make_unique<Branch<DataType>>(this->name_);
+}
+
+}  // namespace hdtree
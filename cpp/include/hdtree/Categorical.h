@@ -0,0 +1,142 @@
+/**
+ * @file Categorical.h
+ * Definition of dictionary-encoded values
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "hdtree/Atomic.h"
+
+namespace hdtree {
+
+template <typename DataType, typename Enable>
+class Branch;
+
+/**
+ * A value from a small set of possible values
+ *
+ * Categorical values are stored on disk as a dictionary of the distinct
+ * values alongside a narrow integer code for each entry pointing into the
+ * dictionary. This is much smaller than storing every value when there are
+ * only a handful of distinct values (e.g. detector names or status labels)
+ * and lets the codes be compared instead of the values.
+ *
+ * ```cpp
+ * auto& det = tree.branch<hdtree::Categorical<std::string>>("detector");
+ * *det = "ECal";
+ * ```
+ *
+ * When reading, the value is decoded by looking it up in the dictionary
+ * held by the branch, so no copies of the value are made.
+ *
+ * ```cpp
+ * auto& det = tree.get<hdtree::Categorical<std::string>>("detector");
+ * auto ecal = det.code_of("ECal");
+ * tree.for_each([&]() {
+ *   if (det->code() == ecal) {
+ *     // entry is from the ECal
+ *   }
+ * });
+ * ```
+ *
+ * @tparam T atomic type of the values
+ * @tparam Code unsigned integer type of the codes, limiting the number of
+ * distinct values
+ */
+template <typename T, typename Code = std::uint16_t>
+class Categorical {
+  static_assert(is_atomic_v<T>, "Categorical values must be an atomic type.");
+  static_assert(std::is_integral_v<Code> and std::is_unsigned_v<Code>,
+                "Categorical codes must be an unsigned integer type.");
+
+ public:
+  /// type of the values
+  using value_type = T;
+  /// type of the codes
+  using code_type = Code;
+
+  /// default constructor required by serialization
+  Categorical() = default;
+
+  /**
+   * Create a categorical holding the input value
+   * @param[in] value value to hold
+   */
+  Categorical(T value) : value_{std::move(value)} {}
+
+  /**
+   * Set the value we hold
+   * @param[in] value new value to hold
+   * @return reference to us
+   */
+  Categorical& operator=(T value) {
+    value_ = std::move(value);
+    dictionary_.reset();
+    code_ = 0;
+    return *this;
+  }
+
+  /**
+   * Get the value we hold
+   *
+   * If we were loaded from disk, this is a reference into the
+   * dictionary of the branch we were loaded from.
+   *
+   * @return const reference to our value
+   */
+  const T& value() const {
+    return dictionary_ ? (*dictionary_)[code_] : value_;
+  }
+
+  /// implicit conversion to our value
+  operator const T&() const { return value(); }
+
+  /**
+   * Get the code for our value in the dictionary
+   *
+   * The code is only meaningful once we have been loaded from or saved to
+   * a branch and it is only comparable to other codes from the same branch.
+   *
+   * @return code of our value
+   */
+  Code code() const { return code_; }
+
+  /**
+   * Compare the values of two categoricals
+   * @param[in] other categorical to compare to
+   * @return true if the values are the same
+   */
+  bool operator==(const Categorical& other) const {
+    if (dictionary_ and dictionary_ == other.dictionary_)
+      return code_ == other.code_;
+    return value() == other.value();
+  }
+
+  /**
+   * Compare our value to the input value
+   * @param[in] other value to compare to
+   * @return true if our value is the same
+   */
+  bool operator==(const T& other) const { return value() == other; }
+
+  /**
+   * Reset to a default-constructed value
+   */
+  void clear() { *this = T{}; }
+
+ private:
+  /// the branch sets the code and dictionary
+  friend class Branch<Categorical<T, Code>, void>;
+  /// the value when we are not pointing into a dictionary
+  T value_{};
+  /// code of our value in the dictionary
+  Code code_{0};
+  /// the dictionary of the branch we were loaded from
+  std::shared_ptr<const std::vector<T>> dictionary_;
+};
+
+}  // namespace hdtree
@@ -0,0 +1,200 @@
+/**
+ * @file ChunkAppender.h
+ * Definition of appending rows of data sets onto another chunk by chunk
+ */
+#pragma once
+
+#include <deque>
+#include <future>
+#include <optional>
+#include <vector>
+
+// using HighFive
+#include <highfive/H5DataSet.hpp>
+
+#include "hdtree/Compression.h"
+#include "hdtree/Concurrency.h"
+
+namespace hdtree {
+
+/**
+ * Appending the rows of input data sets onto the end of an output
+ * data set, chunk by chunk
+ *
+ * This works for a data set of any HDF5 type without knowing the C++
+ * type it holds, so it is used to concatenate trees (see merge) and to
+ * copy branches that are passed through a transform untouched
+ * (see Reader::copy).
+ *
+ * When we know the filters of the output data set, we write whole
+ * chunks directly. Whenever the end of the output is at a chunk boundary
+ * and the input rows start at a chunk boundary of an input with the same
+ * chunks, filters, and type, the raw chunks of the input are copied
+ * without decompressing them. Otherwise, the rows are decompressed by
+ * HDF5 into a pending partial chunk and each time it fills up, it is
+ * compressed (on the pool of threads if we have one) and written.
+ *
+ * Packed bools are unpacked into the pending chunk so that inputs
+ * whose number of bools is not a multiple of eight line up. The rows
+ * of packed bools are counted in bools rather than bytes.
+ *
+ * Data sets that we can't write chunks for ourselves (e.g. those
+ * holding variable-length strings) are copied through HDF5 in blocks.
+ *
+ * @note The HDF5 lock must be held by the thread using this and the
+ * tasks of the pool it compresses on must not need the lock.
+ */
+class ChunkAppender {
+ public:
+  /**
+   * Start appending to the input data set
+   *
+   * If the data set ends with a partial chunk, we read it back
+   * into our pending chunk so it can be filled up.
+   *
+   * @throws HDTreeException if the data set holds packed bools but
+   * we don't know its filters
+   *
+   * @param[in] out data set to append to
+   * @param[in] pool threads to compress chunks on, nullptr to compress
+   * them on this thread
+   * @param[in] max_compressing maximum number of chunks being compressed
+   */
+  ChunkAppender(HighFive::DataSet out, ThreadPool* pool = nullptr,
+                std::size_t max_compressing = 1);
+
+  /**
+   * Wait for any chunks still being compressed since they refer to us
+   */
+  ~ChunkAppender();
+
+  /// no copying since the chunks being compressed refer to us
+  ChunkAppender(const ChunkAppender&) = delete;
+  /// no copying since the chunks being compressed refer to us
+  ChunkAppender& operator=(const ChunkAppender&) = delete;
+
+  /**
+   * Append all of the rows of the input data set
+   * @param[in] in data set to append
+   */
+  void append(const HighFive::DataSet& in);
+
+  /**
+   * Append some of the rows of the input data set
+   * @param[in] in data set to append from
+   * @param[in] begin first row (or bool if packed) to append
+   * @param[in] end one past the last row (or bool if packed) to append
+   */
+  void append(const HighFive::DataSet& in, std::size_t begin,
+              std::size_t end);
+
+  /**
+   * Write the pending partial chunk and wait for all of the
+   * chunks to be written
+   *
+   * The partial chunk is padded with zeros up to a whole chunk like
+   * HDF5 does, and the data set is shrunk to the real number of rows.
+   */
+  void finish();
+
+ private:
+  /**
+   * Read rows of a data set as our type
+   * @param[in] ds data set to read from
+   * @param[in] begin first row to read
+   * @param[in] n number of rows to read
+   * @param[out] dest memory to read the rows into
+   */
+  void read_rows(const HighFive::DataSet& ds, std::size_t begin,
+                 std::size_t n, void* dest) const;
+
+  /**
+   * Make sure the output data set is at least the input size
+   * @param[in] n_rows minimum number of rows
+   */
+  void extend(std::size_t n_rows);
+
+  /**
+   * Copy a chunk of the input directly onto the end of the output
+   *
+   * Chunks that were never written are decompressed as zeros instead.
+   *
+   * @param[in] in data set to copy from
+   * @param[in] i_row first row of the chunk to copy
+   */
+  void copy_chunk(const HighFive::DataSet& in, std::size_t i_row);
+
+  /**
+   * Compress every whole chunk in the pending rows
+   */
+  void emit_chunks();
+
+  /**
+   * Compress a chunk
+   *
+   * The chunk is assigned its place at the end of the output now
+   * and written once it is done (and all of the chunks before it are).
+   *
+   * @param[in] chunk rows of the chunk, or bools for packed bools
+   * @param[in] n_rows number of real rows in the chunk
+   */
+  void compress(std::vector<char> chunk, std::size_t n_rows);
+
+  /**
+   * Write the oldest chunk being compressed once it is done
+   */
+  void write_next();
+
+  /**
+   * Append the rows of the input data set through HDF5 in blocks
+   *
+   * Variable-length strings are read as pointers allocated by
+   * HDF5 which we free after writing them.
+   *
+   * @param[in] in data set to append from
+   * @param[in] begin first row to append
+   * @param[in] end one past the last row to append
+   */
+  void append_through_hdf5(const HighFive::DataSet& in, std::size_t begin,
+                           std::size_t end);
+
+ private:
+  /// a chunk being compressed
+  struct Compressing {
+    /// row of the output the chunk starts at
+    std::size_t i_row;
+    /// number of real rows in the chunk
+    std::size_t n_rows;
+    /// the compressed chunk
+    std::future<std::vector<char>> raw;
+  };
+
+  /// the data set we are appending to
+  HighFive::DataSet out_;
+  /// threads compressing chunks (if any)
+  ThreadPool* pool_;
+  /// maximum number of chunks being compressed at once
+  std::size_t max_compressing_;
+  /// the type of the output data set
+  HighFive::DataType type_;
+  /// size of an element of the output data set in bytes
+  std::size_t elem_size_;
+  /// number of rows in each chunk of the output
+  std::size_t chunk_rows_;
+  /// the filters of the output chunks, if we know them
+  std::optional<ChunkFilters> filters_;
+  /// are these packed bools?
+  bool packed_;
+  /// are we writing chunks ourselves?
+  bool direct_;
+  /// rows of the output that have been assigned to chunks
+  std::size_t rows_;
+  /// total number of bools in the output (if packed)
+  std::size_t bits_{0};
+  /// the rows (or bools) of the partial chunk at the end of the output
+  std::vector<char> pending_;
+  /// the chunks being compressed in the order they were submitted
+  std::deque<Compressing> compressing_;
+};
+
+}  // namespace hdtree
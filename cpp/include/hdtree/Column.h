@@ -0,0 +1,365 @@
+/**
+ * @file Column.h
+ * Definition of reading whole columns of a branch at once
+ */
+#pragma once
+
+#include "hdtree/Branch.h"
+#include "hdtree/EntryRange.h"
+
+namespace hdtree {
+
+/**
+ * Reading the values of a branch for a range of entries directly
+ *
+ * This bypasses the event loop (and the read buffers) entirely,
+ * reading the values of an atomic branch (or the flattened content of
+ * a vector branch) with large selections straight into contiguous
+ * memory. HDF5 converts the values from the type on disk into the
+ * requested type, so a column of floats can be read as doubles.
+ *
+ * The whole column can be read at once,
+ * ```cpp
+ * std::vector<double> x = tree.column<double>("x");
+ * ```
+ * or, for columns larger than memory, in chunks of entries.
+ * ```cpp
+ * for (const auto& x : tree.column_reader<double>("x", 1 << 20)) {
+ *   // x holds the values of the next 2^20 entries
+ * }
+ * ```
+ *
+ * @tparam T arithmetic type to read the values as
+ */
+template <typename T>
+class Column {
+  static_assert(std::is_arithmetic_v<T> and not std::is_same_v<T, bool>,
+                "Columns are only available for arithmetic types but bool.");
+
+ public:
+  /**
+   * Iterator through the chunks of a column
+   *
+   * Each chunk is read when the iterator is advanced,
+   * overwriting the previous one.
+   */
+  class iterator {
+   public:
+    /**
+     * Create an iterator through the input column
+     * @param[in] column column to read chunks from, nullptr for the end
+     */
+    explicit iterator(Column* column) : column_{column} {}
+    /// read the next chunk
+    iterator& operator++() {
+      if (not column_->next()) column_ = nullptr;
+      return *this;
+    }
+    /// the values in the current chunk
+    const std::vector<T>& operator*() const { return column_->chunk(); }
+    /// are we at a different place than the other iterator?
+    bool operator!=(const iterator& other) const {
+      return column_ != other.column_;
+    }
+
+   private:
+    /// the column we are reading, nullptr at the end
+    Column* column_;
+  };
+
+  /**
+   * Open the column of the input branch
+   *
+   * For vector branches, we sum the sizes of the entries before and
+   * within the range to find where their content is.
+   *
+   * @throws HDTreeException if the branch is not an arithmetic branch
+   * or a vector of them
+   *
+   * @param[in] f reader holding the branch
+   * @param[in] branch_name name of branch to read
+   * @param[in] entries range of entries to read
+   * @param[in] chunk_entries number of entries in each chunk,
+   * zero to read the whole range in one chunk
+   */
+  Column(const Reader& f, const std::string& branch_name,
+         const EntryRange& entries, std::size_t chunk_entries = 0)
+      : Column(f, branch_name, entries, values_of(f, branch_name, entries),
+               chunk_entries) {}
+
+  /**
+   * Open the column of the input branch knowing where its values are
+   *
+   * This skips summing the sizes of the entries, so the columns of
+   * many ranges can share a single pass over the sizes.
+   *
+   * @see value_offsets for finding the values of each range
+   *
+   * @throws HDTreeException if the branch is not an arithmetic branch
+   * or a vector of them
+   *
+   * @param[in] f reader holding the branch
+   * @param[in] branch_name name of branch to read
+   * @param[in] entries range of entries to read
+   * @param[in] values range of the values of those entries
+   * @param[in] chunk_entries number of entries in each chunk,
+   * zero to read the whole range in one chunk
+   */
+  Column(const Reader& f, const std::string& branch_name,
+         const EntryRange& entries, const EntryRange& values,
+         std::size_t chunk_entries = 0)
+      : entries_{entries},
+        chunk_entries_{chunk_entries > 0 ? chunk_entries : entries.size()},
+        begin_value_{values.begin},
+        n_values_{values.size()},
+        i_entry_{entries.begin},
+        i_value_{values.begin} {
+    auto lock = hdf5_lock();
+    if (is_vector(f, branch_name)) {
+      sizes_ = f.getDataSet(branch_name + "/" + constants::SIZE_NAME);
+      data_ = f.getDataSet(branch_name + "/data");
+    } else {
+      data_ = f.getDataSet(branch_name);
+    }
+  }
+
+  /**
+   * Find the index of the first value of each of the input entries
+   *
+   * For vector branches, we sum the sizes in blocks in one pass so we
+   * don't need them all in memory. The values of atomic branches are
+   * their entries.
+   *
+   * @throws HDTreeException if the branch is not an arithmetic branch
+   * or a vector of them
+   *
+   * @param[in] f reader holding the branch
+   * @param[in] branch_name name of branch to find the values of
+   * @param[in] entries sorted indices of entries
+   * @return index of the first value of each entry
+   */
+  static std::vector<std::size_t> value_offsets(
+      const Reader& f, const std::string& branch_name,
+      const std::vector<std::size_t>& entries) {
+    auto lock = hdf5_lock();
+    if (not is_vector(f, branch_name)) return entries;
+    auto sizes_ds = f.getDataSet(branch_name + "/" + constants::SIZE_NAME);
+    const std::size_t block{1 << 20};
+    std::vector<std::size_t> offsets, sizes;
+    std::size_t i_entry{0}, offset{0};
+    for (std::size_t entry : entries) {
+      while (i_entry < entry) {
+        sizes.resize(std::min(block, entry - i_entry));
+        sizes_ds.select({i_entry}, {sizes.size()})
+            .read(sizes.data(), HighFive::create_datatype<std::size_t>());
+        offset = std::accumulate(sizes.begin(), sizes.end(), offset);
+        i_entry += sizes.size();
+      }
+      offsets.push_back(offset);
+    }
+    return offsets;
+  }
+
+  /**
+   * Release the data sets while holding the HDF5 lock
+   */
+  ~Column() {
+    auto lock = hdf5_lock();
+    data_.reset();
+    sizes_.reset();
+  }
+
+  /// no copying
+  Column(const Column&) = delete;
+  /// no copying
+  Column& operator=(const Column&) = delete;
+
+  /**
+   * Number of values in the whole column
+   *
+   * For vector branches, this is the total size of all of the vectors.
+   *
+   * @return number of values
+   */
+  std::size_t size() const { return n_values_; }
+
+  /**
+   * Read the whole column into the input memory
+   *
+   * This is done in a single selection.
+   *
+   * @param[out] dest memory to write size() values into
+   */
+  void read(T* dest) const {
+    if (n_values_ == 0) return;
+    auto lock = hdf5_lock();
+    data_->select({begin_value_}, {n_values_})
+        .read(dest, HighFive::create_datatype<T>());
+  }
+
+  /**
+   * Read the whole column into a new vector
+   * @return vector holding the values of the column
+   */
+  std::vector<T> read() const {
+    std::vector<T> values(n_values_);
+    read(values.data());
+    return values;
+  }
+
+  /**
+   * Read the next chunk of entries
+   *
+   * @see chunk for the values that were read
+   *
+   * @return false if there are no more entries to read
+   */
+  bool next() {
+    if (i_entry_ >= entries_.end) return false;
+    std::size_t n_entries = std::min(chunk_entries_, entries_.end - i_entry_);
+    std::size_t n_values{n_entries};
+    if (sizes_) {
+      auto lock = hdf5_lock();
+      read_sizes(i_entry_, n_entries, chunk_sizes_);
+      n_values = std::accumulate(chunk_sizes_.begin(), chunk_sizes_.end(),
+                                 std::size_t{0});
+    }
+    chunk_.resize(n_values);
+    if (n_values > 0) {
+      auto lock = hdf5_lock();
+      data_->select({i_value_}, {n_values})
+          .read(chunk_.data(), HighFive::create_datatype<T>());
+    }
+    i_entry_ += n_entries;
+    i_value_ += n_values;
+    return true;
+  }
+
+  /**
+   * The values of the chunk that was last read
+   * @return values of the entries in the chunk
+   */
+  const std::vector<T>& chunk() const { return chunk_; }
+
+  /**
+   * The sizes of the vectors in the chunk that was last read
+   * @return sizes of the entries in the chunk, empty if not a vector branch
+   */
+  const std::vector<std::size_t>& chunk_sizes() const { return chunk_sizes_; }
+
+  /// start reading the chunks
+  iterator begin() { return ++iterator(this); }
+  /// past the last chunk
+  iterator end() { return iterator(nullptr); }
+
+ private:
+  /**
+   * Check that the input branch can be read as a column
+   *
+   * Columns hold the values of an atomic arithmetic branch or the
+   * content of a vector of them. Other groups (e.g. maps or flat
+   * strings, which have the same layout as a vector of bytes) and
+   * other data sets (e.g. strings or packed bools) are refused.
+   *
+   * @note The HDF5 lock must be held.
+   *
+   * @throws HDTreeException if the branch can't be read as a column
+   *
+   * @param[in] f reader holding the branch
+   * @param[in] branch_name name of branch to check
+   * @return true if the branch is a vector
+   */
+  static bool is_vector(const Reader& f, const std::string& branch_name) {
+    std::string data_name{branch_name};
+    bool vector{f.getH5ObjectType(branch_name) == HighFive::ObjectType::Group};
+    bool readable{not vector};
+    if (vector) {
+      data_name += "/data";
+      auto members = f.list(branch_name);
+      try {
+        readable =
+            f.type(branch_name).first.rfind(constants::VECTOR_TYPE, 0) == 0 and
+            std::find(members.begin(), members.end(), constants::SIZE_NAME) !=
+                members.end() and
+            std::find(members.begin(), members.end(), "data") !=
+                members.end() and
+            f.getH5ObjectType(data_name) == HighFive::ObjectType::Dataset;
+      } catch (const HighFive::Exception&) {
+        // groups without a type are not branches
+        readable = false;
+      }
+    }
+    if (readable) {
+      auto ds = f.getDataSet(data_name);
+      auto type_class = ds.getDataType().getClass();
+      readable = (type_class == HighFive::DataTypeClass::Integer or
+                  type_class == HighFive::DataTypeClass::Float) and
+                 not ds.hasAttribute(constants::SIZE_NAME);
+    }
+    if (not readable) {
+      throw HDTreeException(
+          "Branch '" + branch_name +
+              "' is not an arithmetic branch or a vector of them.",
+          "Only the values of atomic arithmetic branches (other than bools) "
+          "and the content of vectors of them can be read as columns.");
+    }
+    return vector;
+  }
+
+  /**
+   * Find the range of the values of the input entries
+   *
+   * @see value_offsets
+   *
+   * @param[in] f reader holding the branch
+   * @param[in] branch_name name of branch to find the values of
+   * @param[in] entries range of entries
+   * @return range of the values of the entries
+   */
+  static EntryRange values_of(const Reader& f, const std::string& branch_name,
+                              const EntryRange& entries) {
+    auto offsets = value_offsets(f, branch_name, {entries.begin, entries.end});
+    return {offsets[0], offsets[1]};
+  }
+
+  /**
+   * Read the sizes of some of the vectors
+   *
+   * @note The HDF5 lock must be held.
+   *
+   * @param[in] start first entry to read the size of
+   * @param[in] n number of sizes to read
+   * @param[out] sizes vector to read the sizes into
+   */
+  void read_sizes(std::size_t start, std::size_t n,
+                  std::vector<std::size_t>& sizes) const {
+    sizes.resize(n);
+    if (n == 0) return;
+    sizes_->select({start}, {n})
+        .read(sizes.data(), HighFive::create_datatype<std::size_t>());
+  }
+
+ private:
+  /// the entries we are reading
+  EntryRange entries_;
+  /// number of entries in each chunk
+  std::size_t chunk_entries_;
+  /// the data set holding the values
+  std::optional<HighFive::DataSet> data_;
+  /// the data set holding the sizes of the vectors (if a vector branch)
+  std::optional<HighFive::DataSet> sizes_;
+  /// index of the first value of the first entry in the range
+  std::size_t begin_value_{0};
+  /// number of values of the entries in the range
+  std::size_t n_values_{0};
+  /// the next entry to read
+  std::size_t i_entry_;
+  /// index of the first value of the next entry to read
+  std::size_t i_value_{0};
+  /// the values of the last chunk
+  std::vector<T> chunk_;
+  /// the sizes of the vectors of the last chunk
+  std::vector<std::size_t> chunk_sizes_;
+};
+
+}  // namespace hdtree
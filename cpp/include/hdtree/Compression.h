@@ -0,0 +1,99 @@
+/**
+ * @file Compression.h
+ * Applying the HDF5 filters to chunks of data ourselves
+ */
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+// using HighFive
+#include <highfive/H5DataSet.hpp>
+
+namespace hdtree {
+
+/**
+ * The filters that are applied to each chunk of an HDTree data set
+ *
+ * HDF5 applies the filters in its pipeline serially while holding its
+ * global lock. By replicating the filters that HDTree uses, we can
+ * compress and decompress chunks on many threads and then have HDF5
+ * directly write or read the already-filtered chunks.
+ */
+struct ChunkFilters {
+  /// byte-shuffle the elements before deflating them
+  bool shuffle{false};
+  /// the deflate (zlib) compression level, negative for no deflate
+  int deflate_level{-1};
+};
+
+/**
+ * Apply the input filters to a chunk of data
+ *
+ * The filters are applied in the same order as HDF5 does when
+ * they are added to the data set creation properties by Writer:
+ * the shuffle and then the deflate.
+ *
+ * @throws HDTreeException if zlib fails to compress the chunk
+ *
+ * @param[in] data pointer to the start of the chunk in memory
+ * @param[in] n_bytes size of the chunk in bytes
+ * @param[in] elem_size size of a single element in bytes
+ * @param[in] filters the filters to apply
+ * @return filtered bytes ready to be written directly into the data set
+ */
+std::vector<char> compress_chunk(const void* data, std::size_t n_bytes,
+                                 std::size_t elem_size,
+                                 const ChunkFilters& filters);
+
+/**
+ * Deduce the number of rows in each chunk of the input data set
+ *
+ * @param[in] ds data set to inspect
+ * @return number of rows in a chunk, zero if the data set is not
+ * a one-dimensional, chunked data set
+ */
+std::size_t deduce_chunk_rows(const HighFive::DataSet& ds);
+
+/**
+ * Deduce the filters that are applied to the chunks of the input data set
+ *
+ * We only know how to undo the filters that HDTree itself applies,
+ * so any data set using other filters (or using them in a different
+ * order) needs to go through HDF5's filter pipeline.
+ *
+ * @param[in] ds data set to inspect
+ * @return filters applied to the chunks, std::nullopt if the data set
+ * is not chunked or uses filters we don't know how to undo
+ */
+std::optional<ChunkFilters> deduce_chunk_filters(const HighFive::DataSet& ds);
+
+/**
+ * Undo the input filters on a chunk of data read directly from disk
+ *
+ * The filters are undone in the reverse order that compress_chunk
+ * applied them, skipping any filters that HDF5 flagged in the
+ * filter mask as not applied to this chunk.
+ *
+ * Only the first n_wanted elements are copied into the destination
+ * so that partial chunks at the end of a data set can be read into
+ * a buffer which is shorter than a whole chunk.
+ *
+ * @throws HDTreeException if zlib fails to decompress the chunk
+ *
+ * @param[in] raw pointer to the filtered bytes read from disk
+ * @param[in] raw_size number of filtered bytes
+ * @param[in] filter_mask mask from HDF5 flagging filters that were skipped
+ * @param[out] dest memory to write the unfiltered elements into
+ * @param[in] n_elems number of elements in a whole chunk
+ * @param[in] n_wanted number of elements to write into dest
+ * @param[in] elem_size size of a single element in bytes
+ * @param[in] filters the filters to undo
+ */
+void decompress_chunk(const char* raw, std::size_t raw_size,
+                      unsigned int filter_mask, void* dest,
+                      std::size_t n_elems, std::size_t n_wanted,
+                      std::size_t elem_size, const ChunkFilters& filters);
+
+}  // namespace hdtree
@@ -0,0 +1,242 @@
+/**
+ * @file Concurrency.h
+ * Helpers for running parts of HDTree's I/O off of the main thread
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace hdtree {
+
+/**
+ * The mutex guarding all calls into the HDF5 library
+ *
+ * HDF5 is not guaranteed to be built with thread-safety enabled,
+ * so we serialize all of our calls into it with this single
+ * process-wide mutex. It is recursive so that functions holding
+ * the lock can call other functions that also acquire it.
+ *
+ * @return reference to the process-wide HDF5 mutex
+ */
+std::recursive_mutex& hdf5_mutex();
+
+/**
+ * Acquire the lock on the HDF5 library
+ *
+ * Any HighFive objects that are created after this lock should
+ * also be destroyed before it is released since destroying them
+ * also calls into the HDF5 library.
+ *
+ * ```cpp
+ * auto lock = hdf5_lock();
+ * auto ds = tree_.getDataSet(name);
+ * ```
+ *
+ * @return lock held until it goes out of scope
+ */
+inline std::unique_lock<std::recursive_mutex> hdf5_lock() {
+  return std::unique_lock<std::recursive_mutex>(hdf5_mutex());
+}
+
+/**
+ * A simple pool of worker threads executing tasks in the order
+ * that they were submitted
+ *
+ * Tasks are arbitrary callables taking no arguments and the
+ * result (or exception) of each task is delivered through
+ * the std::future returned when it is submitted.
+ *
+ * The queue of tasks waiting for a worker can be bounded so that
+ * fast producers are throttled down to the speed of the workers.
+ */
+class ThreadPool {
+ public:
+  /**
+   * Start the worker threads
+   *
+   * @param[in] n_threads number of worker threads to start
+   * @param[in] max_queued maximum number of tasks waiting for a worker,
+   * zero means the queue is unbounded
+   */
+  explicit ThreadPool(std::size_t n_threads, std::size_t max_queued = 0);
+
+  /**
+   * Finish all of the submitted tasks and then join the workers
+   */
+  ~ThreadPool();
+
+  /**
+   * Submit a new task to the pool
+   *
+   * If the queue of waiting tasks is full, we block until
+   * a worker takes a task off of the queue.
+   *
+   * @tparam Task type of callable to run
+   * @param[in] task callable to run on a worker thread
+   * @return future holding the result of the task
+   */
+  template <typename Task>
+  std::future<std::invoke_result_t<Task>> submit(Task task) {
+    using Result = std::invoke_result_t<Task>;
+    // std::function requires copyable callables so we wrap the
+    // move-only std::packaged_task in a shared pointer
+    auto packaged =
+        std::make_shared<std::packaged_task<Result()>>(std::move(task));
+    auto result = packaged->get_future();
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      task_taken_.wait(lock, [this]() {
+        return max_queued_ == 0 or tasks_.size() < max_queued_;
+      });
+      tasks_.emplace_back([packaged]() { (*packaged)(); });
+    }
+    task_ready_.notify_one();
+    return result;
+  }
+
+  /**
+   * Block until all of the submitted tasks have been completed
+   */
+  void wait();
+
+  /**
+   * Get the number of worker threads in this pool
+   * @return number of workers
+   */
+  std::size_t size() const { return workers_.size(); }
+
+  /// no copying
+  ThreadPool(const ThreadPool&) = delete;
+  /// no copying
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+ private:
+  /**
+   * The loop each worker thread runs, taking tasks
+   * off of the queue until we are stopping
+   */
+  void work();
+
+ private:
+  /// the worker threads
+  std::vector<std::thread> workers_;
+  /// the queue of tasks waiting for a worker
+  std::deque<std::function<void()>> tasks_;
+  /// guard for the task queue and counters
+  std::mutex mutex_;
+  /// signal to the workers that a task is ready (or we are stopping)
+  std::condition_variable task_ready_;
+  /// signal to submitters that a task has been taken off the queue
+  std::condition_variable task_taken_;
+  /// signal to waiters that a task has been completed
+  std::condition_variable task_done_;
+  /// maximum number of tasks waiting in the queue (zero for unbounded)
+  std::size_t max_queued_;
+  /// number of tasks currently being run by workers
+  std::size_t active_{0};
+  /// are we shutting down?
+  bool stopping_{false};
+};
+
+/**
+ * A bounded queue between exactly one producer and one consumer thread
+ *
+ * The queue is a ring buffer where the producer only ever moves the tail
+ * and the consumer only ever moves the head, so no locks are needed;
+ * each side only reads the other's index to check if the ring is full
+ * or empty. The blocking push and pop yield the thread while waiting so
+ * that they can be used between the stages of a pipeline.
+ *
+ * @tparam T type of values being passed
+ */
+template <typename T>
+class SpscQueue {
+ public:
+  /**
+   * Create a queue holding at most the input number of values
+   * @param[in] capacity maximum number of values in the queue
+   */
+  explicit SpscQueue(std::size_t capacity) : ring_(capacity + 1) {}
+
+  /**
+   * Try to put a value on the back of the queue
+   *
+   * Only call this from the producer thread.
+   *
+   * @param[in] value value to push
+   * @return false if the queue is full
+   */
+  bool try_push(T value) {
+    std::size_t tail = tail_.load(std::memory_order_relaxed);
+    std::size_t next = (tail + 1) % ring_.size();
+    if (next == head_.load(std::memory_order_acquire)) return false;
+    ring_[tail] = std::move(value);
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Try to take the value off the front of the queue
+   *
+   * Only call this from the consumer thread.
+   *
+   * @return the value, std::nullopt if the queue is empty
+   */
+  std::optional<T> try_pop() {
+    std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) return std::nullopt;
+    T value = std::move(ring_[head]);
+    head_.store((head + 1) % ring_.size(), std::memory_order_release);
+    return value;
+  }
+
+  /**
+   * Put a value on the back of the queue, waiting for room
+   *
+   * @param[in] value value to push
+   * @param[in] cancelled flag to stop waiting (optional)
+   * @return false if we stopped waiting because we were cancelled
+   */
+  bool push(const T& value, const std::atomic<bool>* cancelled = nullptr) {
+    while (not try_push(value)) {
+      if (cancelled and cancelled->load()) return false;
+      std::this_thread::yield();
+    }
+    return true;
+  }
+
+  /**
+   * Take the value off the front of the queue, waiting for one
+   *
+   * @param[in] cancelled flag to stop waiting (optional)
+   * @return the value, std::nullopt if we stopped waiting because we
+   * were cancelled
+   */
+  std::optional<T> pop(const std::atomic<bool>* cancelled = nullptr) {
+    while (true) {
+      if (auto value = try_pop()) return value;
+      if (cancelled and cancelled->load()) return std::nullopt;
+      std::this_thread::yield();
+    }
+  }
+
+ private:
+  /// the ring holding the values, one slot is always left empty
+  std::vector<T> ring_;
+  /// index of the front of the queue, only moved by the consumer
+  std::atomic<std::size_t> head_{0};
+  /// index past the back of the queue, only moved by the producer
+  std::atomic<std::size_t> tail_{0};
+};
+
+}  // namespace hdtree
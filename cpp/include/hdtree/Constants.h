@@ -19,6 +19,16 @@ struct constants {
   inline static const std::string VERS_ATTR_NAME = "__version__";
   /// the name of the size dataset for variable-length types
   inline static const std::string SIZE_NAME = "__size__";
+  /// the name of the group holding the zone maps of the branches
+  inline static const std::string ZONES_NAME = "__zones__";
+  /// the name of the group holding the key indices of the tree
+  inline static const std::string INDEX_NAME = "__index__";
+  /// the start of the type of categorical branches
+  inline static const std::string CATEGORICAL_TYPE = "hdtree::Categorical<";
+  /// the start of the type of vector branches
+  inline static const std::string VECTOR_TYPE = "std::vector<";
+  /// the name of the member of categorical branches holding the values
+  inline static const std::string DICTIONARY_NAME = "dictionary";
 };
 
 }  // namespace hdtree
@@ -0,0 +1,79 @@
+/**
+ * @file EntryRange.h
+ * Definition of a contiguous range of entries in a tree
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+
+#include "hdtree/Exception.h"
+
+namespace hdtree {
+
+/**
+ * A contiguous range of entries [begin, end) within a tree
+ *
+ * This is used to restrict the processing of a tree to a slice of
+ * its entries, for example to split one large file into many
+ * independent jobs.
+ *
+ * ```cpp
+ * // job i_job of n_jobs only reads its own share of the entries
+ * auto t = hdtree::Tree::load(file, "tree", i_job, n_jobs);
+ * ```
+ */
+struct EntryRange {
+  /// index of the first entry in the range
+  std::size_t begin{0};
+  /// index one past the last entry in the range
+  std::size_t end{0};
+
+  /// number of entries in the range
+  std::size_t size() const { return end - begin; }
+
+  /// true if there are no entries in the range
+  bool empty() const { return end <= begin; }
+
+  /**
+   * Check if the input entry is in this range
+   * @param[in] entry index of entry to check
+   * @return true if begin <= entry < end
+   */
+  bool contains(std::size_t entry) const {
+    return begin <= entry and entry < end;
+  }
+
+  /**
+   * Split this range into a number of nearly-equal shards
+   *
+   * The shards are contiguous and cover the whole range without
+   * overlapping. If the range does not split evenly, the first
+   * shards get one more entry than the last ones.
+   *
+   * @throws HDTreeException if the shard index is not less than
+   * the number of shards
+   *
+   * @param[in] i_shard index of shard to get
+   * @param[in] n_shards total number of shards
+   * @return range of entries in the requested shard
+   */
+  EntryRange shard(std::size_t i_shard, std::size_t n_shards) const {
+    if (i_shard >= n_shards) {
+      throw HDTreeException(
+          "Shard index " + std::to_string(i_shard) +
+              " is not less than the number of shards " +
+              std::to_string(n_shards) + ".",
+          "Shards are indexed from 0 to the number of shards minus one.");
+    }
+    std::size_t per_shard = size() / n_shards;
+    std::size_t extra = size() % n_shards;
+    std::size_t shard_begin =
+        begin + i_shard * per_shard + std::min(i_shard, extra);
+    std::size_t shard_size = per_shard + (i_shard < extra ? 1 : 0);
+    return {shard_begin, shard_begin + shard_size};
+  }
+};
+
+}  // namespace hdtree
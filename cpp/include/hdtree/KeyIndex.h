@@ -0,0 +1,180 @@
+/**
+ * @file KeyIndex.h
+ * Definition of looking up entries by the values of key branches
+ */
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "hdtree/Concurrency.h"
+#include "hdtree/Constants.h"
+#include "hdtree/Exception.h"
+#include "hdtree/Reader.h"
+
+namespace hdtree {
+
+/**
+ * A sorted index of the entries of a tree by the values of key branches
+ *
+ * The index is stored as an N x (K+1) data set of 64-bit integers at
+ * `__index__/<key names joined by commas>` within the tree. Each row
+ * is the K key values of an entry followed by the index of that entry
+ * and the rows are sorted by the keys (and then by the entry).
+ *
+ * Looking up a key is a binary search over the rows on disk, so only
+ * a few blocks of the index are read for each lookup no matter how
+ * large the tree is.
+ *
+ * @see Tree::build_index for building an index
+ * @see Tree::find for looking up entries
+ */
+class KeyIndex {
+ public:
+  /**
+   * Name of the index of the input keys
+   * @param[in] key_names names of the key branches
+   * @return name of the index data set
+   */
+  static std::string name(const std::vector<std::string>& key_names) {
+    std::string joined;
+    for (const auto& key : key_names) {
+      if (not joined.empty()) joined += ",";
+      joined += key;
+    }
+    return joined;
+  }
+
+  /**
+   * Open the index of the input keys
+   *
+   * @throws HDTreeException if there is no index of these keys or it
+   * does not index every entry in the tree
+   *
+   * @param[in] f reader holding the tree
+   * @param[in] key_names names of the key branches, in the order
+   * the index was built with
+   * @param[in] entries number of entries in the tree
+   */
+  KeyIndex(const Reader& f, const std::vector<std::string>& key_names,
+           std::size_t entries)
+      : n_keys_{key_names.size()} {
+    auto lock = hdf5_lock();
+    try {
+      set_ = f.getDataSet(constants::INDEX_NAME + "/" + name(key_names));
+    } catch (const HighFive::Exception&) {
+      throw HDTreeException(
+          "No index of the keys '" + name(key_names) + "'.",
+          "Build the index first with `tree.build_index` on a tree "
+          "opened with `hdtree::Tree::inplace`.");
+    }
+    auto dims = set_->getDimensions();
+    if (dims.size() != 2 or dims.at(1) != n_keys_ + 1 or
+        dims.at(0) != entries) {
+      set_.reset();
+      throw HDTreeException(
+          "Index of the keys '" + name(key_names) +
+              "' does not index every entry in the tree.",
+          "The index needs to be built again after entries are added.");
+    }
+    n_rows_ = dims.at(0);
+  }
+
+  /**
+   * Release the data set while holding the HDF5 lock
+   */
+  ~KeyIndex() {
+    auto lock = hdf5_lock();
+    set_.reset();
+  }
+
+  /// no copying
+  KeyIndex(const KeyIndex&) = delete;
+  /// no copying
+  KeyIndex& operator=(const KeyIndex&) = delete;
+
+  /**
+   * Find the entries with the input key
+   *
+   * @param[in] key values of the key branches
+   * @return indices of the entries with this key in increasing order
+   */
+  std::vector<std::size_t> find(const std::vector<std::int64_t>& key) {
+    // binary search for the first row not less than the key
+    std::size_t lo{0}, hi{n_rows_};
+    while (lo < hi) {
+      std::size_t mid = lo + (hi - lo) / 2;
+      if (compare(row(mid), key) < 0) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    std::vector<std::size_t> entries;
+    for (std::size_t i{lo}; i < n_rows_; i++) {
+      const std::int64_t* r = row(i);
+      if (compare(r, key) != 0) break;
+      entries.push_back(static_cast<std::size_t>(r[n_keys_]));
+    }
+    return entries;
+  }
+
+ private:
+  /**
+   * Compare the keys of a row with the input key
+   * @param[in] r row of the index
+   * @param[in] key values of the key branches
+   * @return negative, zero, or positive if the row is less than,
+   * equal to, or greater than the key
+   */
+  int compare(const std::int64_t* r,
+              const std::vector<std::int64_t>& key) const {
+    for (std::size_t i{0}; i < n_keys_; i++) {
+      if (r[i] != key[i]) return r[i] < key[i] ? -1 : 1;
+    }
+    return 0;
+  }
+
+  /**
+   * Get a row of the index
+   *
+   * The block of rows holding it is read if it isn't the block
+   * we read last.
+   *
+   * @param[in] i index of row
+   * @return pointer to the K+1 values of the row
+   */
+  const std::int64_t* row(std::size_t i) {
+    std::size_t i_block = i / BLOCK_ROWS;
+    if (i_block != i_block_) {
+      std::size_t begin = i_block * BLOCK_ROWS;
+      std::size_t n = std::min(BLOCK_ROWS, n_rows_ - begin);
+      block_.resize(n * (n_keys_ + 1));
+      auto lock = hdf5_lock();
+      set_->select({begin, 0}, {n, n_keys_ + 1})
+          .read(block_.data(), HighFive::create_datatype<std::int64_t>());
+      i_block_ = i_block;
+    }
+    return block_.data() + (i % BLOCK_ROWS) * (n_keys_ + 1);
+  }
+
+ public:
+  /// number of rows in each block of the index that is read (and chunk)
+  static constexpr std::size_t BLOCK_ROWS{4096};
+
+ private:
+  /// the data set holding the index
+  std::optional<HighFive::DataSet> set_;
+  /// number of key branches
+  std::size_t n_keys_;
+  /// number of rows in the index
+  std::size_t n_rows_{0};
+  /// the block of rows we read last
+  std::vector<std::int64_t> block_;
+  /// index of the block of rows we read last
+  std::size_t i_block_{static_cast<std::size_t>(-1)};
+};
+
+}  // namespace hdtree
@@ -0,0 +1,95 @@
+/**
+ * @file Merge.h
+ * Definition of concatenating many HDTrees into one
+ */
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace hdtree {
+
+/**
+ * Concatenate the entries of many trees into a new tree
+ *
+ * All of the input trees need to have the same branches with the same
+ * types and versions (the `__type__` and `__version__` attributes).
+ * The output tree is a copy of the first input tree with the entries
+ * of the other trees appended to it in order, so its `__size__` is
+ * the sum of the sizes of the inputs.
+ *
+ * The data sets are concatenated at the chunk level. Whenever the end
+ * of the output lines up with a chunk boundary and the input is chunked
+ * and filtered the same way, the compressed chunks of the input are
+ * copied directly without decompressing them. The rest of the entries
+ * (e.g. the partial chunk at the end of each input) are decompressed
+ * and re-chunked, compressing the new chunks on many threads.
+ * Variable-length strings are always copied through HDF5.
+ *
+ * The zone maps are concatenated as well, but key indices are dropped
+ * since they would need to be sorted again (see Tree::build_index).
+ *
+ * Categorical branches can't be concatenated since the codes of each
+ * tree point into the dictionary of that tree.
+ *
+ * ```cpp
+ * hdtree::merge({{"job_0.h5", "events"}, {"job_1.h5", "events"}},
+ *               {"merged.h5", "events"});
+ * ```
+ *
+ * @throws HDTreeException if the inputs do not have the same structure,
+ * if there is more than one input and they have categorical branches,
+ * or if HDF5 fails to read or write a chunk
+ *
+ * @param[in] inputs file and tree paths of the trees to concatenate
+ * @param[in] output file and tree path of the new tree, the file is
+ * overwritten if it exists
+ * @param[in] n_threads number of threads compressing chunks, zero to
+ * use one per core
+ * @return number of entries in the new tree
+ */
+std::size_t merge(
+    const std::vector<std::pair<std::string, std::string>>& inputs,
+    const std::pair<std::string, std::string>& output,
+    std::size_t n_threads = 0);
+
+/**
+ * Concatenate many trees into a new tree without copying their entries
+ *
+ * The new tree is a small "chain" of the input trees. It has the same
+ * branches as the inputs, but each of its data sets is an HDF5 virtual
+ * data set mapping its rows onto the data sets of the inputs in order
+ * and its `__size__` is the sum of the sizes of the inputs. Loading it
+ * with Tree::load reads the entries from the input files as they are
+ * needed, so the input files need to stay where they are.
+ *
+ * The input file paths are stored as they are given. HDF5 looks for
+ * relative paths relative to the current directory and then relative
+ * to the directory of the chain file.
+ *
+ * The zone maps are concatenated into the chain file like in merge,
+ * but key indices are dropped. Categorical branches can't be chained
+ * for the same reason they can't be merged.
+ *
+ * ```cpp
+ * hdtree::chain({{"job_0.h5", "events"}, {"job_1.h5", "events"}},
+ *               {"chain.h5", "events"});
+ * auto t = hdtree::Tree::load("chain.h5", "events");
+ * ```
+ *
+ * @throws HDTreeException if the inputs do not have the same structure,
+ * if there is more than one input and they have categorical branches,
+ * if packed bools of an input (other than the last) do not fill their
+ * last byte, or if HDF5 fails to create a virtual data set
+ *
+ * @param[in] inputs file and tree paths of the trees to chain
+ * @param[in] output file and tree path of the chain, the file is
+ * overwritten if it exists
+ * @return number of entries in the chain
+ */
+std::size_t chain(
+    const std::vector<std::pair<std::string, std::string>>& inputs,
+    const std::pair<std::string, std::string>& output);
+
+}  // namespace hdtree
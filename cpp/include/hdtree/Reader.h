@@ -7,6 +7,9 @@
 
 #include "hdtree/AbstractBranch.h"
 #include "hdtree/Atomic.h"
+#include "hdtree/Compression.h"
+#include "hdtree/Concurrency.h"
+#include "hdtree/EntryRange.h"
 #include "hdtree/Writer.h"
 
 namespace hdtree {
@@ -40,14 +43,17 @@ class Reader {
          bool inplace = false);
 
   /**
-   * Get the event objects available in the file
+   * Get the branches available in the tree
    *
-   * We crawl the internal directory structure of the file we have open.
+   * We crawl the internal directory structure of the tree we have open.
+   * Groups without a type are only part of the name of the branches
+   * inside of them, so we recurse into them. The zone maps and key
+   * indices are not branches, so they are skipped.
    *
    * @see type for how we get the name of the class that was used
    * to write the data
    *
-   * @return vector of string pairs `{ obj_name, pass }`
+   * @return vector of string pairs `{ branch_name, type_name }`
    */
   virtual std::vector<std::pair<std::string, std::string>> availableObjects();
 
@@ -62,7 +68,8 @@ class Reader {
    * @param[in] branch_name Name of event object to retrieve type of
    * @return demangled type name in string format and its version number
    */
-  virtual std::pair<std::string, int> type(const std::string& branch_name);
+  virtual std::pair<std::string, int> type(
+      const std::string& branch_name) const;
 
   /**
    * Get the name of this file
@@ -87,6 +94,104 @@ class Reader {
    */
   HighFive::DataSet getDataSet(const std::string& branch_name) const;
 
+  /**
+   * Load the zone map of a branch
+   *
+   * @see Writer::saveZones for how the zone maps are stored
+   *
+   * @param[in] branch_name name of branch to load the zones of
+   * @return min, max and number of entries of each zone in order,
+   * empty if the branch has no zone map
+   */
+  std::vector<double> loadZones(const std::string& branch_name) const;
+
+  /**
+   * Deduce how many rows of the input data set to keep in memory at once
+   *
+   * We want each read from disk to decompress whole chunks exactly once,
+   * so the number of rows is always a multiple of the number of rows
+   * in a chunk of the data set. We fit as many chunks as we can into
+   * the configured read buffer size (without going below one chunk).
+   * If the data set is not chunked (e.g. it is contiguous or virtual),
+   * we simply fit as many rows as we can into the read buffer size.
+   *
+   * @see setReadBufferSize for configuring the target size
+   *
+   * @param[in] ds data set that will be read
+   * @return number of rows to read from the data set at once
+   */
+  std::size_t getReadBufferRows(const HighFive::DataSet& ds) const;
+
+  /**
+   * Set the target size of the in-memory read buffers
+   *
+   * @param[in] bytes target size of each read buffer in bytes
+   */
+  void setReadBufferSize(std::size_t bytes) { read_buffer_size_ = bytes; }
+
+  /**
+   * Get the target size of the in-memory read buffers in bytes
+   * @return read buffer size in bytes
+   */
+  std::size_t getReadBufferSize() const { return read_buffer_size_; }
+
+  /**
+   * Turn on (or off) prefetching of the read buffers
+   *
+   * When prefetching, a background thread reads (and decompresses)
+   * the next buffer of each atomic branch while the current one is
+   * being consumed.
+   *
+   * @param[in] prefetch true to start prefetching
+   */
+  void setPrefetch(bool prefetch);
+
+  /**
+   * Get the thread that is prefetching read buffers
+   *
+   * @return pool holding the prefetching thread, nullptr if we aren't
+   * prefetching
+   */
+  std::shared_ptr<ThreadPool> getPrefetcher() const { return prefetcher_; }
+
+  /**
+   * Set the number of threads decompressing chunks
+   *
+   * When using decompression threads, HDTree reads the raw compressed
+   * chunks of atomic data sets directly from disk and undoes the
+   * deflate and shuffle filters itself on a pool of threads. This
+   * bypasses HDF5's serial filter pipeline so decompression can
+   * use many cores. Data sets that hold variable-length types
+   * (i.e. strings) or use other filters are still read through HDF5.
+   *
+   * @param[in] n_threads number of decompression threads, zero to let
+   * HDF5 decompress chunks serially
+   */
+  void setDecompressionThreads(std::size_t n_threads);
+
+  /**
+   * Get the threads decompressing chunks
+   *
+   * @return pool of decompression threads, nullptr if we aren't
+   * decompressing chunks ourselves
+   */
+  std::shared_ptr<ThreadPool> getDecompressor() const {
+    return decompressor_;
+  }
+
+  /**
+   * Share a pool of decompression threads with another reader
+   *
+   * This is used so that readers of the same tree on different
+   * threads don't each start their own decompression threads.
+   *
+   * @param[in] decompressor pool of threads, nullptr to let HDF5
+   * decompress chunks serially
+   */
+  void setDecompressor(std::shared_ptr<ThreadPool> decompressor) {
+    decompressor_ = std::move(decompressor);
+  }
+
   /**
    * Deduce the type of the dataset requested.
    *
@@ -135,19 +240,43 @@ class Reader {
   virtual bool canCopy() const { return true; }
 
   /**
-   * Copy the input data set to the output file
+   * Copy the input branch to the output file without loading it
+   *
+   * This happens when the input branch has passed the keep/drop rules
+   * of a transform so it is supposed to be copied into the output file;
+   * however, it was never written into the output by the tree.
+   *
+   * The data sets of the branch are copied in bulk, chunk by chunk, no
+   * matter what type they hold (see ChunkAppender). The entries of
+   * members of a branch with a `__size__` data set (e.g. the content
+   * of a vector) are found from the sizes of the entries being copied.
+   * The dictionary of a categorical branch is shared by all of the
+   * entries, so it is always copied in full.
+   * Untouched chunks are moved without decompressing them and, if the
+   * writer has compression threads, the rest are compressed on them.
    *
-   * This happens when the input data set has passed all of the drop/keep
-   * rules so it is supposed to be copied into the output file; however,
-   * noone has accessed it with Event::get yet so an in-memory class object
-   * has not been created for it yet.
+   * If every entry is copied, the zone map of the branch is copied
+   * as well.
    *
-   * @param[in] i_entry entry we are currently on
-   * @param[in] branch_name full event object name
+   * If linking, the data sets are not copied at all when the saved
+   * entries are one contiguous range. Instead, each data set in the
+   * output is a virtual data set reading its rows from our data set
+   * (see Writer::createVirtualDataSet), so the output only stays
+   * readable as long as our file stays where it is. Data sets that
+   * can't be linked (e.g. packed bools starting partway through a byte
+   * or branches whose saved entries have gaps) are copied instead.
+   *
+   * @note The writer should not be writing anything in the background
+   * while this is copying.
+   *
+   * @param[in] branch_name name of branch to copy
+   * @param[in] entries sorted, non-overlapping ranges of entries to copy
    * @param[in] output handle to the writer writing the output file
+   * @param[in] link true to link the data sets rather than copy them
    */
-  virtual void copy(unsigned long int i_entry, const std::string& branch_name,
-                    Writer& output);
+  void copy(const std::string& branch_name,
+            const std::vector<EntryRange>& entries, Writer& output,
+            bool link = false);
 
   /// never want to copy a reader
   Reader(const Reader&) = delete;
@@ -156,59 +285,47 @@ class Reader {
 
  private:
   /**
-   * Mirror the structure of the passed branch_name from us into the output file
+   * Copy an object within a branch and everything inside of it
+   *
+   * @see copy
    *
-   * @param[in] branch_name path to the group (and potential subgroups) to
-   * mirror
-   * @param[in] output output file to mirror this structure to
+   * @param[in] path path to the object within the tree
+   * @param[in] rows sorted, non-overlapping ranges of rows of the object
+   * @param[in] output handle to the writer writing the output file
+   * @param[in] link true to link the data sets rather than copy them
    */
-  void mirror(const std::string& branch_name, Writer& output);
+  void copyObject(const std::string& path, const std::vector<EntryRange>& rows,
+                  Writer& output, bool link);
 
- private:
   /**
-   * A mirror event object
-   *
-   * This type of event object is merely present to "reflect" (pun intended)
-   * the recursive nature of the Branch pattern _without_ knowledge of
-   * any user classes. We need this so we can effectively copy event objects
-   * that are not accessed during processing from the input to the output
-   * file. (The choice on whether to copy or not copy these files is
-   * handled by Event).
-   */
-  class MirrorObject {
-    /// handle to the atomic data type once we get down to that point
-    std::unique_ptr<BaseBranch> data_;
-    /// handle to the size member of this object (if it exists)
-    std::unique_ptr<BaseBranch> size_member_;
-    /// list of sub-objects within this object
-    std::vector<std::unique_ptr<MirrorObject>> obj_members_;
-    /// the last entry that was copied
-    unsigned long int last_entry_{0};
-
-   public:
-    /**
-     * Construct this mirror object and any of its (data or object) children
-     */
-    MirrorObject(const std::string& branch_name, Reader& reader,
-                 Writer& writer);
-
-    /**
-     * Copy the n entries starting from i_entry
-     */
-    void copy(unsigned long int i_entry, unsigned long int n);
-  };
+   * Open the file while holding the HDF5 lock
+   *
+   * The public constructor takes the lock and hands it to us so that
+   * it is held until we return, serializing the opening of the file
+   * with any other threads using HDF5.
+   *
+   * @param[in] file_tree_path file name and path to the tree within it
+   * @param[in] inplace true to open the file for writing as well
+   * @param[in] lock HDF5 lock held while constructing
+   */
+  Reader(const std::pair<std::string, std::string>& file_tree_path,
+         bool inplace, std::unique_lock<std::recursive_mutex> lock);
 
  private:
   /// our highfive file
   HighFive::File file_;
   /// the HighFive group that is our HDTree
   HighFive::Group tree_;
+  /// the path to our HDTree within the file
+  std::string tree_path_;
   /// the number of entries in this file, set in constructor
   std::size_t entries_;
-  /// our in-memory mirror objects for data being copied to the output file
-  /// without processing
-  std::unordered_map<std::string, std::unique_ptr<MirrorObject>>
-      mirror_objects_;
+  /// target size of read buffers in bytes
+  std::size_t read_buffer_size_{1024 * 1024};
+  /// background thread filling read buffers (if prefetching)
+  std::shared_ptr<ThreadPool> prefetcher_;
+  /// threads decompressing chunks (if decompressing chunks ourselves)
+  std::shared_ptr<ThreadPool> decompressor_;
 };  // Reader
 
 }  // namespace hdtree
@@ -1,6 +1,12 @@
 #pragma once
 
+#include "hdtree/Aggregate.h"
+#include "hdtree/Batch.h"
 #include "hdtree/Branch.h"
+#include "hdtree/Column.h"
+#include "hdtree/EntryRange.h"
+#include "hdtree/KeyIndex.h"
+#include "hdtree/ZoneMap.h"
 
 namespace hdtree {
 
@@ -10,17 +16,126 @@ namespace hdtree {
 class Tree {
  public:
   static Tree load(const std::string& file_path, const std::string& tree_path);
+
+  /**
+   * Load only a range of the entries in a tree
+   *
+   * Every branch retrieved with `get` starts at the beginning of the
+   * range without reading the chunks before it and `for_each` stops
+   * at the end of the range.
+   *
+   * @throws HDTreeException if the range is not within the tree
+   *
+   * @param[in] file_path path to file holding the tree
+   * @param[in] tree_path path to tree within the file
+   * @param[in] range entries to load
+   */
+  static Tree load(const std::string& file_path, const std::string& tree_path,
+                   const EntryRange& range);
+
+  /**
+   * Load only one shard of the entries in a tree
+   *
+   * This is helpful for splitting one large file into many independent
+   * jobs, each reading only their own share of the entries.
+   *
+   * @see EntryRange::shard for how the entries are split
+   *
+   * @param[in] file_path path to file holding the tree
+   * @param[in] tree_path path to tree within the file
+   * @param[in] i_shard index of shard to load
+   * @param[in] n_shards total number of shards
+   */
+  static Tree load(const std::string& file_path, const std::string& tree_path,
+                   std::size_t i_shard, std::size_t n_shards);
   static Tree save(const std::string& file_path, const std::string& tree_path);
   static Tree inplace(const std::string& file_path,
                       const std::string& tree_path);
   static Tree transform(const std::pair<std::string, std::string>& src,
                         const std::pair<std::string, std::string>& dest);
 
+  /**
+   * Transform a tree, copying the branches we don't touch
+   *
+   * Each rule is either `keep <glob>` or `drop <glob>` where the glob
+   * is matched against the names of the branches in the input tree
+   * (see `man 7 glob`). The last rule matching a branch decides if it
+   * is kept and branches that don't match any rule are dropped.
+   *
+   * Kept branches that are not written into the output (with `branch`
+   * or `get(name, true)`) are copied into the output when the tree is
+   * closed, including the branches that are only read with `get`.
+   * They are never loaded; instead, the entries that were saved are
+   * copied in bulk, moving whole compressed chunks without decompressing
+   * them whenever they line up (see Reader::copy). Entries can still
+   * be skipped by not saving them, but each loaded entry can only be
+   * saved once.
+   *
+   * ```cpp
+   * // add one branch to a tree, copying all of the others as they are
+   * auto t = hdtree::Tree::transform({"in.h5", "tree"}, {"out.h5", "tree"},
+   *                                  {"keep *", "drop debug_*"});
+   * auto& energy = t.get<double>("energy");
+   * auto& calibrated = t.branch<double>("calibrated_energy");
+   * t.for_each([&]() { *calibrated = 0.9 * *energy; });
+   * ```
+   *
+   * @throws HDTreeException if a rule is not `keep` or `drop` followed
+   * by a glob
+   *
+   * @param[in] src file and tree paths of the input tree
+   * @param[in] dest file and tree paths of the output tree
+   * @param[in] rules keep/drop rules for the untouched branches
+   */
+  static Tree transform(const std::pair<std::string, std::string>& src,
+                        const std::pair<std::string, std::string>& dest,
+                        const std::vector<std::string>& rules);
+
+  /**
+   * Close the tree
+   *
+   * The branches are destructed first, finishing any buffered reads and
+   * writes. Then the writer is flushed and, when transforming with
+   * keep/drop rules, the untouched branches are copied into the output.
+   * Finally, the files are closed while holding the HDF5 lock so that
+   * closing them is safe while other threads are using HDF5.
+   *
+   * The tree can't be used after it is closed and closing it again
+   * does nothing.
+   *
+   * @throws HDTreeException if flushing the writer or copying the
+   * untouched branches fails
+   */
+  void close();
+
+  /**
+   * Close the tree if it wasn't already
+   *
+   * Errors can't be reported while destructing, so they are dropped.
+   * Call `close` first in order to see them.
+   */
+  ~Tree();
+
+  /// trees can be moved
+  Tree(Tree&&) = default;
+  /**
+   * Move another tree into this one
+   *
+   * This tree is torn down like it is when destructed before it takes
+   * over the other tree, so any errors closing it are dropped.
+   * Call `close` first in order to see them.
+   *
+   * @param[in] other tree to move into this one
+   * @return this tree
+   */
+  Tree& operator=(Tree&& other);
+
   /**
    * Create a new branch on the tree
    */
   template <typename DataType>
   Branch<DataType>& branch(const std::string& branch_name) {
+    if (not reader_ and not writer_) return detached<DataType>(branch_name);
     if (branches_.find(branch_name) != branches_.end()) {
       throw HDTreeException(
           "Branch named '" + branch_name + "' was already initialized.",
@@ -37,6 +152,7 @@ class Tree {
     }
     branches_[branch_name] = std::make_unique<Branch<DataType>>(branch_name);
     branches_[branch_name]->attach(*writer_);
+    written_.push_back(branch_name);
     return dynamic_cast<Branch<DataType>&>(*branches_[branch_name]);
   }
 
@@ -46,6 +162,7 @@ class Tree {
   template <typename DataType>
   const Branch<DataType>& get(const std::string& branch_name,
                               bool write = false) {
+    if (not reader_ and not writer_) return detached<DataType>(branch_name);
     if (not reader_) {
       throw HDTreeException(
           "Attempting to 'get' a branch without reading.",
@@ -62,13 +179,478 @@ class Tree {
     }
     branches_[branch_name] = std::make_unique<Branch<DataType>>(branch_name);
     branches_[branch_name]->attach(*reader_);
-    if (not inplace_ and writer_ and write)
+    inputs_.push_back(branches_[branch_name].get());
+    // branches retrieved partway through start at the current entry
+    if (i_entry_ > 0) branches_[branch_name]->seek(i_entry_);
+    if (not inplace_ and writer_ and write) {
       branches_[branch_name]->attach(*writer_);
+      written_.push_back(branch_name);
+    }
     return dynamic_cast<Branch<DataType>&>(*branches_[branch_name]);
   }
 
   /**
-   * loop over all entries in the tree, executing the provided
+   * get a read-only view of a vector branch
+   *
+   * The view of each entry points directly into the buffer of
+   * the branch's content rather than copying it into a std::vector.
+   *
+   * ```cpp
+   * auto& nums = tree.get_view<double>("rand_nums");
+   * tree.for_each([&]() {
+   *   for (double num : *nums) {
+   *     // use num
+   *   }
+   * });
+   * ```
+   *
+   * @note The view of an entry is only valid until the next entry is loaded.
+   *
+   * @tparam ContentType arithmetic type of the content of the vectors
+   * @param[in] branch_name name of vector branch to view
+   * @return branch holding the view of the current entry
+   */
+  template <typename ContentType>
+  const Branch<View<ContentType>>& get_view(const std::string& branch_name) {
+    return get<View<ContentType>>(branch_name);
+  }
+
+  /**
+   * get a branch to be loaded in batches of entries
+   *
+   * The branch can either be an atomic branch or a vector branch of
+   * the input type. Batch branches are only loaded by `for_each_batch`,
+   * so entries cannot be loaded one at a time (e.g. with `for_each`)
+   * once a batch has been retrieved.
+   *
+   * @see Batch for how the values of each batch are accessed
+   *
+   * @throws HDTreeException if we are not reading or the batch
+   * was already retrieved
+   *
+   * @tparam T arithmetic type of the atomic branch or the vector content
+   * @param[in] branch_name name of branch to load in batches
+   * @return batch holding the values of the current batch of entries
+   */
+  template <typename T>
+  const Batch<T>& get_batch(const std::string& branch_name) {
+    if (not reader_) {
+      throw HDTreeException(
+          "Attempting to 'get_batch' a branch without reading.",
+          "Batches are loaded from an input file, make sure you've loaded "
+          "a tree if you wish to 'get_batch' a branch.");
+    }
+    if (batches_.find(branch_name) != batches_.end()) {
+      throw HDTreeException(
+          "Batch of branch named '" + branch_name + "' was already retrieved.",
+          "This usually originates from more than one call to "
+          "`tree.get_batch` with the same input branch name.");
+    }
+    auto loader = std::make_unique<BatchLoader<T>>(branch_name, *reader_);
+    if (i_entry_ > 0) loader->seek(i_entry_);
+    const Batch<T>& batch = loader->batch();
+    batches_[branch_name] = std::move(loader);
+    return batch;
+  }
+
+  /**
+   * open a branch to be read directly as a column
+   *
+   * The column covers the range of entries this tree is loading
+   * and is read independently of any loop over the entries.
+   *
+   * ```cpp
+   * auto x = tree.column_reader<double>("x");
+   * std::vector<double> buffer(x.size());
+   * x.read(buffer.data());
+   * ```
+   *
+   * @see Column for reading the column in chunks
+   *
+   * @throws HDTreeException if we are not reading or the branch is
+   * not an arithmetic branch or a vector of them
+   *
+   * @tparam T arithmetic type to read the values as
+   * @param[in] branch_name name of atomic or vector branch to read
+   * @param[in] chunk_entries number of entries to read in each chunk,
+   * zero to read all of them in one chunk
+   * @return column of the branch
+   */
+  template <typename T>
+  Column<T> column_reader(const std::string& branch_name,
+                          std::size_t chunk_entries = 0) const {
+    if (not reader_) {
+      throw HDTreeException(
+          "Attempting to read a column without reading.",
+          "Columns are read from an input file, make sure you've loaded "
+          "a tree if you wish to read a column.");
+    }
+    return Column<T>(*reader_, branch_name, range_, chunk_entries);
+  }
+
+  /**
+   * read the whole column of a branch
+   *
+   * For vector branches, this is the content of all of the vectors
+   * one after the other.
+   *
+   * @see column_reader
+   *
+   * @tparam T arithmetic type to read the values as
+   * @param[in] branch_name name of atomic or vector branch to read
+   * @return values of the branch for the range of entries this tree
+   * is loading
+   */
+  template <typename T>
+  std::vector<T> column(const std::string& branch_name) const {
+    return column_reader<T>(branch_name).read();
+  }
+
+  /**
+   * find the entries that may pass a cut on a branch
+   *
+   * The zone map of the branch is used to skip the zones of entries
+   * whose values are all outside of the cut. The entries that are
+   * returned still need to be checked, but none of the entries that
+   * were skipped could pass. If the branch has no zone map (e.g. it
+   * is not an arithmetic branch or was written without one, see
+   * `set_zone_maps`), the whole
+   * range of entries this tree is loading is returned.
+   *
+   * ```cpp
+   * auto& energy = tree.get<double>("energy");
+   * auto cut = hdtree::Interval::greater(50.);
+   * for (const auto& r : tree.select("energy", cut)) {
+   *   tree.for_each(r.begin, r.end, [&]() {
+   *     if (*energy > 50.) { ... }
+   *   });
+   * }
+   * ```
+   *
+   * @throws HDTreeException if we are not reading
+   *
+   * @param[in] branch_name name of branch to cut on
+   * @param[in] cut interval the values of the branch need to be in
+   * @return sorted ranges of entries that may pass the cut
+   */
+  std::vector<EntryRange> select(const std::string& branch_name,
+                                 const Interval& cut) const;
+
+  /**
+   * find the entries that may pass all of the input cuts
+   *
+   * ```cpp
+   * auto ranges = tree.select({{"energy", hdtree::Interval::greater(50.)},
+   *                            {"n_hits", hdtree::Interval::less(10)}});
+   * ```
+   *
+   * @see select for how a single cut is applied
+   *
+   * @param[in] cuts pairs of branch names and the interval to cut on
+   * @return sorted ranges of entries that may pass every cut
+   */
+  std::vector<EntryRange> select(
+      const std::vector<std::pair<std::string, Interval>>& cuts) const;
+
+  /**
+   * build an index of the entries by the values of some key branches
+   *
+   * The keys of every entry are read as columns and sorted, then the
+   * index is saved into the file so that `find` can look up entries
+   * without scanning the tree. The index needs to be built again
+   * if entries are added to the tree.
+   *
+   * ```cpp
+   * {
+   *   auto t = hdtree::Tree::inplace("events.h5", "events");
+   *   t.build_index({"run", "event"});
+   * }
+   * ```
+   *
+   * @note All of the keys are held in memory while the index is built.
+   *
+   * @throws HDTreeException if we are not updating a tree in place,
+   * any of the keys is not an atomic integer branch, or any of the
+   * key values does not fit into a 64-bit signed integer
+   *
+   * @param[in] key_names names of the key branches
+   */
+  void build_index(const std::vector<std::string>& key_names);
+
+  /**
+   * find the entries with the input key using an index
+   *
+   * Each lookup is a binary search through the index on disk.
+   * The entries that are found can then be loaded directly.
+   *
+   * ```cpp
+   * auto t = hdtree::Tree::load("events.h5", "events");
+   * auto& energy = t.get<double>("energy");
+   * for (std::size_t entry : t.find({"run", "event"}, {1234, 56789})) {
+   *   t.load(entry);
+   *   // energy of the flagged event
+   * }
+   * ```
+   *
+   * @throws HDTreeException if we are not reading, there is no index
+   * of the keys, or the index is out of date
+   *
+   * @param[in] key_names names of the key branches, in the same order
+   * as the index was built with
+   * @param[in] key values of the key branches to look up
+   * @return indices of the entries with the key in increasing order
+   */
+  std::vector<std::size_t> find(const std::vector<std::string>& key_names,
+                                const std::vector<std::int64_t>& key);
+
+  /**
+   * summarize the values of a branch
+   *
+   * The branch is read in chunks of its column and the sum, sum of
+   * squares, min and max are accumulated with vectorized kernels.
+   * The entries are split into a shard per thread and the partial
+   * summaries of each thread are added together at the end.
+   *
+   * ```cpp
+   * auto energy = tree.reduce<double>("energy");
+   * auto hits = tree.reduce<float>("hit_energies", "weight");
+   * ```
+   *
+   * For vector branches, every value of every vector is filled.
+   * The weights can either be a branch with the same layout as the
+   * values or an atomic branch whose weight is used for every value
+   * in the vector of the same entry.
+   *
+   * @throws HDTreeException if we are not reading or the weights
+   * do not fit the values
+   *
+   * @tparam T arithmetic type to read the values as
+   * @param[in] branch_name name of atomic or vector branch to summarize
+   * @param[in] weight_name name of branch holding the weights,
+   * empty to weight every value by one
+   * @param[in] n_threads number of threads, zero to use one per core
+   * @return summary of the values for the range of entries this tree
+   * is loading
+   */
+  template <typename T>
+  Summary reduce(const std::string& branch_name,
+                 const std::string& weight_name = "",
+                 std::size_t n_threads = 0) const {
+    return aggregate<T>(
+        {branch_name}, weight_name, Summary(),
+        [](Summary& s, const std::vector<const T*>& x, const double* w,
+           std::size_t n) { s.fill(x[0], w, n); },
+        n_threads);
+  }
+
+  /**
+   * histogram the values of a branch
+   *
+   * @see reduce for how the branch is read and weighted
+   *
+   * @tparam T arithmetic type to read the values as
+   * @param[in] branch_name name of atomic or vector branch to histogram
+   * @param[in] x binning of the histogram
+   * @param[in] weight_name name of branch holding the weights,
+   * empty to weight every value by one
+   * @param[in] n_threads number of threads, zero to use one per core
+   * @return histogram of the values for the range of entries this tree
+   * is loading
+   */
+  template <typename T>
+  Histogram histogram(const std::string& branch_name, const Axis& x,
+                      const std::string& weight_name = "",
+                      std::size_t n_threads = 0) const {
+    return aggregate<T>(
+        {branch_name}, weight_name, Histogram(x),
+        [](Histogram& h, const std::vector<const T*>& x, const double* w,
+           std::size_t n) { h.fill(x[0], x[0], w, n); },
+        n_threads);
+  }
+
+  /**
+   * histogram the values of two branches against each other
+   *
+   * The two branches need to have the same layout, for vector
+   * branches this means the vectors of each entry are the same size.
+   *
+   * @see reduce for how the branches are read and weighted
+   *
+   * @tparam T arithmetic type to read the values as
+   * @param[in] x_name name of branch along the first axis
+   * @param[in] y_name name of branch along the second axis
+   * @param[in] x binning of the first axis
+   * @param[in] y binning of the second axis
+   * @param[in] weight_name name of branch holding the weights,
+   * empty to weight every value by one
+   * @param[in] n_threads number of threads, zero to use one per core
+   * @return histogram of the values for the range of entries this tree
+   * is loading
+   */
+  template <typename T>
+  Histogram histogram(const std::string& x_name, const std::string& y_name,
+                      const Axis& x, const Axis& y,
+                      const std::string& weight_name = "",
+                      std::size_t n_threads = 0) const {
+    return aggregate<T>(
+        {x_name, y_name}, weight_name, Histogram(x, y),
+        [](Histogram& h, const std::vector<const T*>& x, const double* w,
+           std::size_t n) { h.fill(x[0], x[1], w, n); },
+        n_threads);
+  }
+
+  /**
+   * Set the target size in bytes of the in-memory buffer for each
+   * atomic branch that is read from the input file
+   *
+   * The buffers are always aligned with the chunks of the data sets on disk,
+   * so the target is rounded down to a whole number of chunks (but never
+   * less than one chunk).
+   *
+   * @note This only applies to branches that are retrieved with `get`
+   * after it is called.
+   *
+   * @param[in] bytes target size of each read buffer in bytes
+   */
+  void set_read_buffer_size(std::size_t bytes);
+
+  /**
+   * Turn on (or off) prefetching of the read buffers
+   *
+   * When prefetching, a background thread reads and decompresses the
+   * next buffer of data for each atomic branch while the current buffer
+   * is being used. This allows the disk I/O and decompression to overlap
+   * with the processing done within `for_each`.
+   *
+   * @note This only applies to branches that are retrieved with `get`
+   * after it is called.
+   *
+   * @param[in] prefetch true to prefetch read buffers in the background
+   */
+  void set_prefetch(bool prefetch);
+
+  /**
+   * Set the number of threads decompressing chunks of the input data sets
+   *
+   * With decompression threads, the raw chunks of each atomic branch are
+   * read directly from disk and HDTree inflates and un-shuffles them on
+   * a pool of threads, bypassing HDF5's serial filter pipeline.
+   * This pairs well with `set_prefetch` so that the chunks for the
+   * next buffer are decompressed in parallel while the current buffer
+   * is being used.
+   *
+   * @note This only applies to branches that are retrieved with `get`
+   * after it is called.
+   *
+   * @param[in] n_threads number of decompression threads (zero to turn off)
+   */
+  void set_decompression_threads(std::size_t n_threads);
+
+  /**
+   * Turn on (or off) writing behind
+   *
+   * When writing behind, full write buffers are handed off to a
+   * background thread which writes (and compresses) them while the
+   * next entries are being filled. This avoids the latency spike
+   * in `save` whenever a buffer fills up. The write-behind queue is
+   * drained when the tree is destroyed.
+   *
+   * @note This only applies to branches that are created after it is called.
+   *
+   * @param[in] write_behind true to write full buffers in the background
+   * @param[in] max_queued maximum number of full buffers waiting to be
+   * written before `save` blocks
+   */
+  void set_write_behind(bool write_behind, std::size_t max_queued = 16);
+
+  /**
+   * Set the number of threads compressing chunks of the output data sets
+   *
+   * With compression threads, each full chunk of an atomic branch is
+   * shuffled and deflated by HDTree on a pool of threads and then written
+   * directly into the data set, bypassing HDF5's serial filter pipeline.
+   * The resulting file is identical in format to one written without
+   * compression threads.
+   *
+   * @note This only applies to branches that are created after it is called.
+   *
+   * @param[in] n_threads number of compression threads (zero to turn off)
+   */
+  void set_compression_threads(std::size_t n_threads);
+
+  /**
+   * Turn on (or off) packing bool branches eight bools to a byte
+   *
+   * This shrinks bool branches (e.g. trigger bits) by about a factor
+   * of eight on disk. Reading them back in with HDTree is transparent,
+   * but other readers need to unpack the bits themselves.
+   *
+   * @note This only applies to bool branches that are created with
+   * `branch` after it is called.
+   *
+   * @param[in] pack true to pack bools into bits
+   */
+  void set_pack_bools(bool pack);
+
+  /**
+   * Turn on (or off) storing string branches in the flat layout
+   *
+   * Flat strings are stored like a vector of bytes rather than as
+   * HDF5 variable-length strings, making them much faster to read
+   * and write and letting them compress well. Reading them back in
+   * with HDTree is transparent.
+   *
+   * @note This only applies to string branches that are created with
+   * `branch` after it is called.
+   *
+   * @param[in] flat true to store strings in the flat layout
+   */
+  void set_flat_strings(bool flat);
+
+  /**
+   * Turn on (or off) recording zone maps for arithmetic branches
+   *
+   * Zone maps are off by default. They hold the min, max and number of
+   * entries of each chunk of a branch so that `select` can skip chunks
+   * that cannot pass a cut when the file is read.
+   *
+   * @note This only applies to branches that are created with
+   * `branch` after it is called.
+   *
+   * @param[in] zone_maps true to record zone maps
+   */
+  void set_zone_maps(bool zone_maps);
+
+  /**
+   * Turn on (or off) linking the untouched branches instead of copying
+   *
+   * When transforming with keep/drop rules, the kept branches that are
+   * never retrieved are copied into the output. With this on, they are
+   * linked instead: each of their data sets in the output is an HDF5
+   * virtual data set reading its rows from the input file, so only the
+   * new (or retrieved and saved) branches are written and a derived tree
+   * costs as much as its new branches. The output is only readable while
+   * the input file stays where it is.
+   *
+   * Branches are only linked when the saved entries are one contiguous
+   * range of the input, otherwise they are copied.
+   *
+   * ```cpp
+   * auto t = hdtree::Tree::transform({"in.h5", "tree"}, {"friend.h5", "tree"},
+   *                                  {"keep *"});
+   * t.set_link_untouched(true);
+   * ```
+   *
+   * @see Reader::copy for how the branches are linked
+   *
+   * @throws HDTreeException if we are not transforming with keep/drop rules
+   *
+   * @param[in] link true to link the untouched branches
+   */
+  void set_link_untouched(bool link);
+
+  /**
+   * loop over the remaining entries in the tree, executing the provided
    * function on each call
    *
    * auto& i_entry = tree.branch<int>("i_entry");
@@ -76,6 +658,11 @@ class Tree {
    * tree.for_each([&]() {
    *   *two_i_entry = 2*(*i_entry);
    * });
+   *
+   * If the tree was loaded with a range of entries, we only loop over
+   * the entries in that range. Like the other loops, we continue from
+   * the entry we are at, so entries that were already loaded (or
+   * seeked past) are not looped over again.
    */
   template <class UnaryFunction>
   void for_each(UnaryFunction body) {
@@ -89,13 +676,397 @@ class Tree {
           "to be stored (for example at the end of the body of a for-loop)."
           );
     }
-    for (std::size_t i{0}; i < this->entries_; i++) {
+    for_each(i_entry_, range_.end, body);
+  }
+
+  /**
+   * loop over the entries [begin, end) in the tree, executing the
+   * provided function on each call
+   *
+   * If we are not already at the first entry, we seek to it.
+   *
+   * @throws HDTreeException if we need to seek but are not only reading
+   * or the range is not within the tree
+   *
+   * @param[in] begin index of first entry to process
+   * @param[in] end index one past the last entry to process
+   * @param[in] body function to call on each entry
+   */
+  template <class UnaryFunction>
+  void for_each(std::size_t begin, std::size_t end, UnaryFunction body) {
+    if (begin < range_.begin or end > range_.end or begin > end) {
+      throw HDTreeException(
+          "Attempting to loop over entries [" + std::to_string(begin) + ", " +
+              std::to_string(end) + ") which are not within the entries [" +
+              std::to_string(range_.begin) + ", " +
+              std::to_string(range_.end) + ") of the tree.");
+    }
+    if (begin != i_entry_) this->seek(begin);
+    for (std::size_t i{begin}; i < end; i++) {
       this->load();
       body();
       this->save();
     }
   }
 
+  /**
+   * loop over the remaining entries in the tree in batches, executing the
+   * provided function on each batch
+   *
+   * Each batch of entries is loaded into the batches retrieved with
+   * `get_batch` before calling the body with the range of entries in
+   * the batch. This removes the per-entry (and per-branch) dispatch of
+   * `for_each` so the body can loop over the contiguous values of each
+   * branch directly.
+   *
+   * ```cpp
+   * auto& x = tree.get_batch<float>("x");
+   * double sum{0.};
+   * tree.for_each_batch(4096, [&](const hdtree::EntryRange& entries) {
+   *   for (float v : x.values()) sum += v;
+   * });
+   * ```
+   *
+   * Batches that are a multiple of the rows in a chunk line up with
+   * the read buffers so that the values are never copied.
+   *
+   * @note Only batches are loaded, so branches cannot be retrieved with
+   * `get` and nothing can be saved.
+   *
+   * @throws HDTreeException if we are not only reading or branches
+   * have been retrieved with `get`
+   *
+   * @param[in] batch_size maximum number of entries in each batch
+   * @param[in] body function to call with the range of each batch
+   */
+  template <class BatchFunction>
+  void for_each_batch(std::size_t batch_size, BatchFunction body) {
+    if (not reader_ or writer_) {
+      throw HDTreeException(
+          "Attempting to loop over batches while not only reading.",
+          "Batches of entries are only loaded from trees that are only "
+          "reading (`hdtree::Tree::load`).");
+    }
+    if (not inputs_.empty()) {
+      throw HDTreeException(
+          "Attempting to loop over batches with branches loaded entry by "
+          "entry.",
+          "Retrieve all of the branches with `tree.get_batch` rather than "
+          "`tree.get` when looping over batches.");
+    }
+    batch_size = std::max<std::size_t>(batch_size, 1);
+    while (i_entry_ < range_.end) {
+      EntryRange entries{i_entry_,
+                         std::min(i_entry_ + batch_size, range_.end)};
+      for (auto& [_name, batch] : batches_) batch->load(entries.size());
+      i_entry_ = entries.end;
+      body(entries);
+    }
+  }
+
+  /**
+   * loop over the remaining entries in the tree on many threads
+   *
+   * The entries are split into one contiguous shard per thread. Each
+   * thread gets its own copy of this tree opened on the same input file
+   * with its own branches and read buffers, so no branches are shared
+   * between threads. The worker for each copy is made by `make_worker`
+   * (which should `get` the branches it needs from the copy it is given)
+   * and then called once per entry in its shard. After all of the
+   * threads are done, `merge` is called with each worker in the order
+   * of their shards on the calling thread so the per-thread results
+   * can be combined without any locking.
+   *
+   * ```cpp
+   * struct Sum {
+   *   const hdtree::Branch<double>& x;
+   *   double sum{0.};
+   *   void operator()() { sum += *x; }
+   * };
+   * double total{0.};
+   * tree.parallel_for_each(
+   *     [](hdtree::Tree& t) { return Sum{t.get<double>("x")}; },
+   *     [&](Sum& s) { total += s.sum; });
+   * ```
+   *
+   * All calls into HDF5 are still serialized by the HDF5 lock, so the
+   * threads only speed up the work that happens outside of HDF5: the
+   * body of the workers, copying out of the read buffers and, if
+   * decompression threads are set on this tree, decompressing chunks.
+   * The copies share this tree's decompression threads and use the
+   * same read buffer size and prefetching as this tree.
+   *
+   * @note The branches of this tree are not loaded by this loop.
+   *
+   * @throws HDTreeException if we are not only reading or if any
+   * of the workers throws
+   *
+   * @tparam MakeWorker callable taking a Tree& and returning the worker
+   * @tparam Merge callable taking a reference to a worker
+   * @param[in] make_worker function making the worker for each copy
+   * @param[in] merge function combining the results of each worker
+   * @param[in] n_threads number of threads, zero to use one per core
+   */
+  template <class MakeWorker, class Merge>
+  void parallel_for_each(MakeWorker make_worker, Merge merge,
+                         std::size_t n_threads = 0) {
+    if (not reader_ or writer_) {
+      throw HDTreeException(
+          "Attempting to loop on many threads while not only reading.",
+          "Entries are saved in the order they are visited, so looping on "
+          "many threads is only allowed for trees that are only reading "
+          "(`hdtree::Tree::load`).");
+    }
+    EntryRange todo{i_entry_, range_.end};
+    if (n_threads == 0) n_threads = std::thread::hardware_concurrency();
+    n_threads = std::max<std::size_t>(std::min(n_threads, todo.size()), 1);
+
+    using Worker = std::invoke_result_t<MakeWorker&, Tree&>;
+    std::vector<Tree> trees;
+    trees.reserve(n_threads);
+    for (std::size_t i_thread{0}; i_thread < n_threads; i_thread++) {
+      trees.push_back(copy_for(todo.shard(i_thread, n_threads)));
+    }
+    std::vector<Worker> workers;
+    workers.reserve(n_threads);
+    for (auto& tree : trees) workers.push_back(make_worker(tree));
+
+    {
+      ThreadPool pool(n_threads);
+      std::vector<std::future<void>> done;
+      for (std::size_t i_thread{0}; i_thread < n_threads; i_thread++) {
+        done.push_back(pool.submit(
+            [&tree = trees[i_thread], &worker = workers[i_thread]]() {
+              tree.for_each(std::ref(worker));
+            }));
+      }
+      // all threads need to finish before we rethrow since they are
+      // using the trees and workers we own
+      for (auto& thread : done) thread.wait();
+      for (auto& thread : done) thread.get();
+    }
+
+    for (auto& worker : workers) merge(worker);
+
+    workers.clear();
+    trees.clear();
+  }
+
+  /**
+   * loop over the remaining entries in the tree, computing each entry
+   * on many threads while still saving the entries in order
+   *
+   * The branches that are used must be retrieved from this tree with
+   * `get` and `branch` as usual before calling this. We then make a
+   * window of copies of these branches that are not attached to any file
+   * and call `make_worker` once for each copy; the worker it returns
+   * should `get` and `branch` the same branches from the copy it is given.
+   *
+   * The loop is done as a pipeline. This thread loads each entry and
+   * copies it into a free copy of the branches, handing that copy's worker
+   * off to a pool of threads. Once the window is full, this thread waits
+   * for the oldest entry to finish, exchanges its results back into our
+   * branches and saves them, freeing that copy for the next entry.
+   * The window is a first-in-first-out reorder buffer, so the entries are
+   * saved in exactly the same order (and with exactly the same content)
+   * as `for_each` would have saved them.
+   *
+   * ```cpp
+   * auto& x = tree.get<double>("x");
+   * auto& y = tree.branch<double>("y");
+   * tree.parallel_transform([](hdtree::Tree& entry) {
+   *   auto& x = entry.get<double>("x");
+   *   auto& y = entry.branch<double>("y");
+   *   return [&x, &y]() { *y = expensive(*x); };
+   * });
+   * ```
+   *
+   * @note Views cannot be used since they point into the read buffers
+   * that are refilled as later entries are loaded.
+   *
+   * @throws HDTreeException if we are not reading and writing or if
+   * any of the workers throws
+   *
+   * @tparam MakeWorker callable taking a Tree& and returning a callable
+   * processing one entry
+   * @param[in] make_worker function making the worker for each copy
+   * @param[in] n_threads number of threads computing entries,
+   * zero to use one per core
+   * @param[in] window maximum number of entries being computed at once,
+   * zero to use four per thread
+   */
+  template <class MakeWorker>
+  void parallel_transform(MakeWorker make_worker, std::size_t n_threads = 0,
+                          std::size_t window = 0) {
+    if (not reader_ or not writer_) {
+      throw HDTreeException(
+          "Attempting to transform on many threads without reading and "
+          "writing.",
+          "Only trees that are loading entries from an input file and "
+          "saving them to an output file (`hdtree::Tree::transform` or "
+          "`hdtree::Tree::inplace`) can be transformed.");
+    }
+    if (n_threads == 0) n_threads = std::thread::hardware_concurrency();
+    n_threads = std::max<std::size_t>(n_threads, 1);
+    if (window == 0) window = 4 * n_threads;
+    window = std::max(window, n_threads);
+
+    using Worker = std::invoke_result_t<MakeWorker&, Tree&>;
+    std::vector<Tree> copies;
+    copies.reserve(window);
+    for (std::size_t i_copy{0}; i_copy < window; i_copy++) {
+      copies.push_back(detached_copy());
+    }
+    std::vector<Worker> workers;
+    workers.reserve(window);
+    for (auto& copy : copies) workers.push_back(make_worker(copy));
+
+    // declared after the copies and workers so that it finishes
+    // any entries still being computed before they are destructed
+    ThreadPool pool(n_threads);
+    std::deque<std::pair<std::size_t, std::future<void>>> in_flight;
+    // entries are saved in the order they were loaded
+    const std::size_t begin{i_entry_};
+    std::size_t i_saved{begin};
+    auto save_oldest = [&]() {
+      auto [i_copy, done] = std::move(in_flight.front());
+      in_flight.pop_front();
+      done.get();
+      for (auto& [name, br] : branches_) {
+        br->swap(*copies[i_copy].branches_.at(name));
+      }
+      this->save_loaded(i_saved++);
+      return i_copy;
+    };
+
+    for (std::size_t i{begin}; i < range_.end; i++) {
+      std::size_t n_started{i - begin};
+      std::size_t i_copy = n_started < window ? n_started : save_oldest();
+      this->load();
+      for (auto& [name, br] : copies[i_copy].branches_) {
+        br->copy_from(*branches_.at(name));
+      }
+      // like save, we clear so the next entry's new branches start blank
+      for (auto& [_name, br] : branches_) br->clear();
+      in_flight.emplace_back(
+          i_copy, pool.submit([&worker = workers[i_copy]]() { worker(); }));
+    }
+    while (not in_flight.empty()) save_oldest();
+  }
+
+  /**
+   * loop over the remaining entries in the tree as a three-stage pipeline
+   *
+   * This does the same thing as `for_each` but the loading of the
+   * entries is moved onto its own thread so that reading and
+   * decompressing the next entries overlaps with calling the body.
+   *
+   * - A reader thread loads entries into a ring of `depth` detached
+   *   copies of the input branches using its own copy of this tree
+   *   opened on the same input file.
+   * - This thread takes each loaded copy in order, swaps it into our
+   *   input branches, calls the body and saves the entry.
+   * - The saved entries are written by the write-behind thread (and
+   *   compression threads) of this tree's writer, if they are turned
+   *   on before the branches are made.
+   *
+   * The loaded and free copies are passed between the reader thread and
+   * this thread with lock-free single-producer single-consumer queues.
+   * Only swaps are done, so the data of each entry is never copied.
+   *
+   * ```cpp
+   * auto t = hdtree::Tree::transform({"in.h5", "tree"}, {"out.h5", "tree"});
+   * t.set_write_behind(true);
+   * t.set_compression_threads(4);
+   * auto& x = t.get<std::vector<double>>("x");
+   * auto& sum = t.branch<double>("sum");
+   * t.pipelined_for_each([&]() {
+   *   for (double v : *x) *sum += v;
+   * });
+   * ```
+   *
+   * @note Views cannot be used since they point into the read buffers
+   * that are refilled as later entries are loaded.
+   *
+   * @note The read buffers of our input branches are not moved by this
+   * loop, so `seek` before loading from this tree again.
+   *
+   * @throws HDTreeException if we are not reading or if loading an
+   * entry fails
+   *
+   * @param[in] body function to call on each entry
+   * @param[in] depth number of entries the reader thread can load ahead
+   */
+  template <class UnaryFunction>
+  void pipelined_for_each(UnaryFunction body, std::size_t depth = 16) {
+    if (not reader_) {
+      throw HDTreeException(
+          "No reader configured, so there are no entries to pipeline.",
+          "The pipelined loop overlaps loading entries from an input file "
+          "with the body of the loop, so it needs a tree that is reading.");
+    }
+    depth = std::max<std::size_t>(depth, 1);
+
+    Tree source = copy_inputs();
+    std::vector<std::vector<std::unique_ptr<BaseBranch>>> slots(depth);
+    for (auto& slot : slots) {
+      for (auto* br : inputs_) slot.push_back(br->sprout());
+    }
+    SpscQueue<std::size_t> free(depth), ready(depth);
+    for (std::size_t i_slot{0}; i_slot < depth; i_slot++) free.push(i_slot);
+    std::atomic<bool> cancelled{false};
+    std::size_t n_entries{range_.end - i_entry_};
+
+    // declared last so the reader thread is joined before
+    // anything it is using is destructed
+    ThreadPool reader(1);
+    auto loaded = reader.submit([&]() {
+      try {
+        for (std::size_t i{0}; i < n_entries; i++) {
+          auto i_slot = free.pop(&cancelled);
+          if (not i_slot) return;
+          source.load();
+          for (std::size_t i_br{0}; i_br < source.inputs_.size(); i_br++) {
+            slots[*i_slot][i_br]->swap(*source.inputs_[i_br]);
+          }
+          ready.push(*i_slot);
+        }
+      } catch (...) {
+        // an index past the slots tells the loop that we failed
+        ready.push(depth);
+        throw;
+      }
+    });
+
+    try {
+      for (std::size_t i{0}; i < n_entries; i++) {
+        std::size_t i_slot = *ready.pop();
+        if (i_slot == depth) break;
+        for (std::size_t i_br{0}; i_br < inputs_.size(); i_br++) {
+          inputs_[i_br]->swap(*slots[i_slot][i_br]);
+        }
+        i_entry_++;
+        body();
+        this->save();
+        free.push(i_slot);
+      }
+    } catch (...) {
+      cancelled = true;
+      throw;
+    }
+    loaded.get();
+  }
+
+  /**
+   * the range of entries we are loading
+   *
+   * This is all of the entries in the input tree unless the tree was
+   * loaded with a specific range.
+   *
+   * @return range of entries, empty if not reading
+   */
+  const EntryRange& range() const { return range_; }
+
   /**
    * end-of-event call back
    *
@@ -106,16 +1077,122 @@ class Tree {
    *
    * At the end, we also inform the writer (if there is one) that the number of
    * entries in the tree has incremented.
+   *
+   * @throws HDTreeException if we are copying untouched branches and
+   * the last entry loaded was already saved (or none was loaded)
    */
   void save();
 
+  /**
+   * append the values of many entries to an atomic branch at once
+   *
+   * The values are copied directly into the write buffer of the branch
+   * in large blocks. Once all of the branches have been filled with the
+   * same number of entries, call `save(n)` to finish saving them.
+   *
+   * ```cpp
+   * auto t = hdtree::Tree::save("out.h5", "tree");
+   * t.branch<double>("x");
+   * t.branch<std::vector<int>>("hits");
+   * t.fill_column("x", x.data(), n);
+   * t.fill_column("hits", hits.data(), offsets.data(), n);
+   * t.save(n);
+   * ```
+   *
+   * @throws HDTreeException if we are not only writing or the branch
+   * was not made with `branch` for the same type
+   *
+   * @tparam T atomic type of the branch
+   * @param[in] branch_name name of branch to fill
+   * @param[in] values pointer to the values of the n entries
+   * @param[in] n number of entries to fill
+   */
+  template <typename T>
+  void fill_column(const std::string& branch_name, const T* values,
+                   std::size_t n) {
+    filled<T>(branch_name, n).save(values, n);
+  }
+
+  /**
+   * append the content of many entries to a vector branch at once
+   *
+   * The content of entry i is [offsets[i], offsets[i+1]) within the
+   * content, like the offsets of a Batch.
+   *
+   * @see fill_column for how to save the entries
+   *
+   * @tparam T atomic type of the content of the vectors
+   * @param[in] branch_name name of branch to fill
+   * @param[in] content pointer to the content of the n entries
+   * @param[in] offsets pointer to the n+1 offsets of each entry into
+   * the content
+   * @param[in] n number of entries to fill
+   */
+  template <typename T>
+  void fill_column(const std::string& branch_name, const T* content,
+                   const std::size_t* offsets, std::size_t n) {
+    auto& br = filled<std::vector<T>>(branch_name, n);
+    std::vector<std::size_t> sizes(n);
+    std::adjacent_difference(offsets + 1, offsets + n + 1, sizes.begin());
+    if (n > 0) sizes[0] = offsets[1] - offsets[0];
+    br.save(content + offsets[0], sizes.data(), n);
+  }
+
+  /**
+   * finish saving entries that were filled by columns
+   *
+   * Every branch must have been filled with the input number
+   * of entries by `fill_column` since the last save.
+   *
+   * @throws HDTreeException if a branch was not filled with n entries
+   *
+   * @param[in] n number of entries that were filled
+   */
+  void save(std::size_t n);
+
   /**
    * start-of-event call back
    *
    * we go through and load each branch that is in this tree
+   *
+   * @throws HDTreeException if branches have been retrieved with
+   * `get_batch` since they are only loaded in batches
    */
   void load();
 
+  /**
+   * move to an entry in the input tree
+   *
+   * The next call to load will load the input entry. Each atomic branch
+   * jumps directly to the block of chunks containing the entry without
+   * reading the chunks before it. Variable-length branches find where
+   * the content of the entry starts by summing the sizes of the entries
+   * before it; these sums are cached so the sizes are read only once.
+   *
+   * ```cpp
+   * auto& nums = tree.get<std::vector<double>>("nums");
+   * tree.load(42);
+   * // nums holds entry 42
+   * ```
+   *
+   * @note Only the branches retrieved with `get` before seeking are moved.
+   *
+   * @throws HDTreeException if we are not only reading or the entry is
+   * past the end of the tree
+   *
+   * @param[in] entry index of entry to move to
+   */
+  void seek(std::size_t entry);
+
+  /**
+   * load a specific entry from the input tree
+   *
+   * This is a short hand for seeking to the entry and then loading it.
+   *
+   * @param[in] entry index of entry to load
+   */
+  void load(std::size_t entry);
+
  private:
   /**
    * The tree constructor is private because it is complicated,
@@ -124,17 +1201,297 @@ class Tree {
   Tree(const std::pair<std::string, std::string>& src,
        const std::pair<std::string, std::string>& dest);
 
+  /**
+   * Open a copy of this tree restricted to the input range
+   *
+   * The copy reads the same input tree with the same read buffer
+   * size and prefetching, sharing our decompression threads.
+   *
+   * @param[in] range entries for the copy to load
+   * @return copy of this tree only reading the range
+   */
+  Tree copy_for(const EntryRange& range) const;
+
+  /**
+   * Make a copy of our branches that is not attached to any file
+   *
+   * The copy has neither a reader nor a writer, so `get` and `branch`
+   * on it return the copies of our branches instead of making new ones.
+   *
+   * @return tree holding a detached copy of each of our branches
+   */
+  Tree detached_copy() const;
+
+  /**
+   * Open a copy of this tree loading the same input branches
+   *
+   * The copy starts at our current entry with the same
+   * read buffer size and prefetching, sharing our decompression threads.
+   *
+   * @see copy_for
+   *
+   * @return copy of this tree holding copies of our input branches
+   */
+  Tree copy_inputs() const;
+
+  /**
+   * Get a branch for filling by columns
+   *
+   * @throws HDTreeException if we are not only writing or there is no
+   * branch with the input name holding the input type
+   *
+   * @tparam DataType type of data held by the branch
+   * @param[in] branch_name name of branch to fill
+   * @param[in] n number of entries being filled
+   * @return the branch
+   */
+  template <typename DataType>
+  Branch<DataType>& filled(const std::string& branch_name, std::size_t n) {
+    if (not writer_ or reader_) {
+      throw HDTreeException(
+          "Attempting to fill a column while not only writing.",
+          "Columns can only be filled on trees that are only saving "
+          "(`hdtree::Tree::save`).");
+    }
+    auto it = branches_.find(branch_name);
+    Branch<DataType>* br{nullptr};
+    if (it != branches_.end()) {
+      br = dynamic_cast<Branch<DataType>*>(it->second.get());
+    }
+    if (not br) {
+      throw HDTreeException(
+          "Branch named '" + branch_name + "' of the requested type was not "
+          "made before filling its column.",
+          "Make the branch with `tree.branch` before filling it.");
+    }
+    filled_[branch_name] += n;
+    return *br;
+  }
+
+  /**
+   * Accumulate the columns of some branches on many threads
+   *
+   * Each thread reads the columns of its shard of the entries in chunks
+   * and fills its own copy of the result which are added together in
+   * order once all of the threads are done. The reading is serialized
+   * by the HDF5 lock but the filling is not.
+   *
+   * @throws HDTreeException if we are not reading, the branches can't
+   * be read as columns, the columns do not have the same layout, or the
+   * weights do not fit the values
+   *
+   * @tparam T arithmetic type to read the values as
+   * @tparam Result type being accumulated, must be addable with +=
+   * @tparam Fill callable filling a Result with the values of a chunk
+   * @param[in] names names of the branches to read the values of
+   * @param[in] weight_name name of branch holding the weights, may be empty
+   * @param[in] empty result before anything is filled
+   * @param[in] fill function filling a result from a chunk of the columns
+   * @param[in] n_threads number of threads, zero to use one per core
+   * @return accumulated result
+   */
+  template <typename T, class Result, class Fill>
+  Result aggregate(const std::vector<std::string>& names,
+                   const std::string& weight_name, const Result& empty,
+                   Fill fill, std::size_t n_threads) const {
+    if (not reader_) {
+      throw HDTreeException(
+          "Attempting to aggregate a branch without reading.",
+          "Branches are aggregated from an input file, make sure you've "
+          "loaded a tree if you wish to aggregate its branches.");
+    }
+    if (n_threads == 0) n_threads = std::thread::hardware_concurrency();
+    n_threads = std::max<std::size_t>(std::min(n_threads, range_.size()), 1);
+    const std::size_t chunk_entries{1 << 16};
+
+    // find where the values of each shard begin before starting the
+    // threads so the sizes of the entries are only summed once
+    std::vector<std::size_t> bounds;
+    for (std::size_t i_thread{0}; i_thread < n_threads; i_thread++) {
+      bounds.push_back(range_.shard(i_thread, n_threads).begin);
+    }
+    bounds.push_back(range_.end);
+    std::vector<std::vector<std::size_t>> offsets;
+    for (const auto& name : names) {
+      offsets.push_back(Column<T>::value_offsets(*reader_, name, bounds));
+    }
+    if (not weight_name.empty()) {
+      offsets.push_back(
+          Column<double>::value_offsets(*reader_, weight_name, bounds));
+    }
+
+    std::vector<Result> partials(n_threads, empty);
+    auto work = [&](std::size_t i_thread) {
+      EntryRange shard = range_.shard(i_thread, n_threads);
+      auto values = [&](std::size_t i) {
+        return EntryRange{offsets[i][i_thread], offsets[i][i_thread + 1]};
+      };
+      std::vector<std::unique_ptr<Column<T>>> columns;
+      for (std::size_t i{0}; i < names.size(); i++) {
+        columns.push_back(std::make_unique<Column<T>>(
+            *reader_, names[i], shard, values(i), chunk_entries));
+      }
+      std::unique_ptr<Column<double>> weights;
+      if (not weight_name.empty()) {
+        weights = std::make_unique<Column<double>>(
+            *reader_, weight_name, shard, values(names.size()), chunk_entries);
+      }
+      std::vector<const T*> x(names.size());
+      std::vector<double> broadcast;
+      while (columns[0]->next()) {
+        const auto& sizes = columns[0]->chunk_sizes();
+        std::size_t n = columns[0]->chunk().size();
+        for (std::size_t i{0}; i < columns.size(); i++) {
+          if (i > 0) columns[i]->next();
+          if (columns[i]->chunk_sizes() != sizes or
+              columns[i]->chunk().size() != n) {
+            throw HDTreeException(
+                "Branches '" + names[0] + "' and '" + names[i] +
+                    "' do not have the same layout.",
+                "Branches aggregated together need to have the same "
+                "number of values in each entry.");
+          }
+          x[i] = columns[i]->chunk().data();
+        }
+        const double* w{nullptr};
+        if (weights) {
+          weights->next();
+          const auto& values = weights->chunk();
+          if (weights->chunk_sizes() == sizes and values.size() == n) {
+            w = values.data();
+          } else if (weights->chunk_sizes().empty()) {
+            // one weight per entry for every value in its vector
+            broadcast.clear();
+            for (std::size_t i{0}; i < sizes.size(); i++) {
+              broadcast.insert(broadcast.end(), sizes[i], values[i]);
+            }
+            w = broadcast.data();
+          } else {
+            throw HDTreeException(
+                "Weights '" + weight_name + "' do not fit the values of '" +
+                    names[0] + "'.",
+                "The weights need to either have the same layout as the "
+                "values or be an atomic branch with one weight per entry.");
+          }
+        }
+        fill(partials[i_thread], x, w, n);
+      }
+    };
+
+    {
+      ThreadPool pool(n_threads);
+      std::vector<std::future<void>> done;
+      for (std::size_t i_thread{0}; i_thread < n_threads; i_thread++) {
+        done.push_back(pool.submit([&work, i_thread]() { work(i_thread); }));
+      }
+      for (auto& thread : done) thread.wait();
+      for (auto& thread : done) thread.get();
+    }
+
+    Result result{partials[0]};
+    for (std::size_t i{1}; i < partials.size(); i++) result += partials[i];
+    return result;
+  }
+
+  /**
+   * Get a branch from a detached copy
+   *
+   * @throws HDTreeException if there is no branch with the input name
+   * or it holds a different type
+   *
+   * @tparam DataType type of data held by the branch
+   * @param[in] branch_name name of branch to get
+   * @return the branch
+   */
+  template <typename DataType>
+  Branch<DataType>& detached(const std::string& branch_name) {
+    auto it = branches_.find(branch_name);
+    Branch<DataType>* br{nullptr};
+    if (it != branches_.end()) {
+      br = dynamic_cast<Branch<DataType>*>(it->second.get());
+    }
+    if (not br) {
+      throw HDTreeException(
+          "Branch named '" + branch_name + "' of the requested type was not "
+          "retrieved from the tree before transforming on many threads.",
+          "Each worker can only use the branches that were retrieved with "
+          "`tree.get` or `tree.branch` before `tree.parallel_transform`.");
+    }
+    return *br;
+  }
+
+ private:
+  /**
+   * Save the entry that was loaded from the input entry
+   *
+   * @see save
+   *
+   * @param[in] i_entry index of the input entry being saved
+   */
+  void save_loaded(std::size_t i_entry);
+
+  /**
+   * Should the input branch be kept by our keep/drop rules?
+   * @param[in] branch_name name of branch in the input tree
+   * @return true if the last rule matching it is a keep rule
+   */
+  bool kept(const std::string& branch_name) const;
+
+  /**
+   * Copy the kept branches that were never retrieved into the output
+   *
+   * @see Reader::copy
+   *
+   * @param[in] written names of the branches that were written
+   */
+  void copy_untouched(const std::vector<std::string>& written);
+
  private:
-  /// the branches in this tree
-  std::unordered_map<std::string, std::unique_ptr<BaseBranch>> branches_;
   /// the number of entries in this tree (if reading from a file)
   std::optional<std::size_t> entries_;
   /// reader if loading from a file
   std::unique_ptr<Reader> reader_;
   /// writer if writing to a file
   std::unique_ptr<Writer> writer_;
+  /**
+   * the branches in this tree
+   *
+   * These are declared after the reader and writer so that they are
+   * destructed first, finishing any buffered reads and writes before
+   * the files are closed.
+   */
+  std::unordered_map<std::string, std::unique_ptr<BaseBranch>> branches_;
+  /**
+   * the branches loaded from the input file
+   *
+   * New branches made with `branch` are only saved,
+   * so they should not be loaded or moved.
+   */
+  std::vector<BaseBranch*> inputs_;
+  /// the number of entries filled by columns since the last save
+  std::unordered_map<std::string, std::size_t> filled_;
+  /// the branches being loaded in batches
+  std::unordered_map<std::string, std::unique_ptr<BaseBatchLoader>> batches_;
+  /// the key indices that have been opened
+  std::unordered_map<std::string, std::unique_ptr<KeyIndex>> indices_;
   /// are we reading from and writing to the same file?
   bool inplace_{false};
+  /// the range of entries we are loading
+  EntryRange range_;
+  /// the index of the next entry to be loaded
+  std::size_t i_entry_{0};
+  /// the file and tree paths we are reading from (if reading)
+  std::pair<std::string, std::string> src_;
+  /// the keep/drop rules as pairs of glob and true if keeping
+  std::vector<std::pair<std::string, bool>> rules_;
+  /// the ranges of input entries that were saved (if copying untouched)
+  std::vector<EntryRange> saved_;
+  /// link the untouched branches rather than copying them
+  bool link_untouched_{false};
+  /// the names of the branches written into the output
+  std::vector<std::string> written_;
+  /// has this tree been closed?
+  bool closed_{false};
 };
 
 }  // namespace hdtree
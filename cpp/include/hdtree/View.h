@@ -0,0 +1,99 @@
+/**
+ * @file View.h
+ * Definition of a read-only view of contiguous data
+ */
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace hdtree {
+
+/**
+ * A read-only view of a contiguous run of values
+ *
+ * This is a minimal stand-in for C++20's std::span<const T> so that we
+ * can hand out the content of variable-length branches without copying
+ * it into a std::vector.
+ *
+ * A view does not own the memory it points to. Views loaded from a
+ * branch are only valid until the next time that branch is loaded.
+ *
+ * @tparam T type of values being viewed
+ */
+template <typename T>
+class View {
+ public:
+  /// type of the values
+  using value_type = T;
+  /// iterator through the values
+  using const_iterator = const T*;
+
+  /// an empty view
+  View() = default;
+
+  /**
+   * View the input run of values
+   * @param[in] data pointer to the first value
+   * @param[in] size number of values
+   */
+  View(const T* data, std::size_t size) : data_{data}, size_{size} {}
+
+  /**
+   * View the contents of the input vector
+   * @param[in] vec vector to view
+   */
+  View(const std::vector<T>& vec) : data_{vec.data()}, size_{vec.size()} {}
+
+  /// pointer to the first value
+  const T* data() const { return data_; }
+  /// number of values
+  std::size_t size() const { return size_; }
+  /// true if there are no values
+  bool empty() const { return size_ == 0; }
+  /// iterator to the first value
+  const_iterator begin() const { return data_; }
+  /// iterator past the last value
+  const_iterator end() const { return data_ + size_; }
+  /// access the i'th value without bounds checking
+  const T& operator[](std::size_t i) const { return data_[i]; }
+  /// the first value
+  const T& front() const { return data_[0]; }
+  /// the last value
+  const T& back() const { return data_[size_ - 1]; }
+
+  /**
+   * Copy the values into a vector that owns them
+   * @return vector holding a copy of the values
+   */
+  std::vector<T> to_vector() const { return std::vector<T>(begin(), end()); }
+
+  /**
+   * Compare the values we view to the values in the input vector
+   * @param[in] vec vector to compare to
+   * @return true if the values are the same
+   */
+  bool operator==(const std::vector<T>& vec) const {
+    if (size_ != vec.size()) return false;
+    for (std::size_t i{0}; i < size_; i++) {
+      if (not(data_[i] == vec[i])) return false;
+    }
+    return true;
+  }
+
+  /**
+   * Reset to an empty view
+   */
+  void clear() {
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+ private:
+  /// pointer to the first value
+  const T* data_{nullptr};
+  /// number of values
+  std::size_t size_{0};
+};
+
+}  // namespace hdtree
@@ -1,12 +1,16 @@
 #pragma once
 
 #include <boost/core/demangle.hpp>
+#include <cstdint>
+#include <exception>
 #include <utility>
 
 // using HighFive
 #include <highfive/H5File.hpp>
 
 #include "hdtree/Atomic.h"
+#include "hdtree/Compression.h"
+#include "hdtree/Concurrency.h"
 #include "hdtree/Constants.h"
 #include "hdtree/Exception.h"
 
@@ -34,6 +38,9 @@ class Writer {
 
   /**
    * Close up our file, making sure to flush contents to disk
+   *
+   * Errors can't be reported while destructing, so call flush
+   * first in order to see them.
    */
   ~Writer();
 
@@ -42,17 +49,186 @@ class Writer {
    */
   int getRowsPerChunk() const { return rows_per_chunk_; }
 
+  /**
+   * Turn on (or off) writing behind
+   *
+   * When writing behind, full write buffers are handed to a background
+   * thread which extends the data sets, compresses the data, and writes
+   * it to disk. This keeps the time spent in each save short and steady.
+   *
+   * @param[in] write_behind true to write full buffers in the background
+   * @param[in] max_queued maximum number of full buffers waiting to be
+   * written before saving blocks
+   */
+  void setWriteBehind(bool write_behind, std::size_t max_queued = 16);
+
+  /**
+   * Get the thread that is writing full buffers in the background
+   *
+   * @return pool holding the writing thread, nullptr if we aren't
+   * writing behind
+   */
+  std::shared_ptr<ThreadPool> getFlusher() const { return flusher_; }
+
+  /**
+   * Set the number of threads compressing chunks
+   *
+   * When using compression threads, HDTree applies the shuffle
+   * and deflate filters to each full chunk itself on a pool of
+   * threads and then writes the compressed chunk directly into
+   * the data set. This bypasses HDF5's serial filter pipeline
+   * so compression can use many cores. Data sets whose elements
+   * are variable length (i.e. strings) are still written through
+   * HDF5's filter pipeline.
+   *
+   * @param[in] n_threads number of compression threads, zero to let
+   * HDF5 compress chunks serially
+   */
+  void setCompressionThreads(std::size_t n_threads);
+
+  /**
+   * Get the threads compressing chunks
+   *
+   * @return pool of compression threads, nullptr if we aren't
+   * compressing chunks ourselves
+   */
+  std::shared_ptr<ThreadPool> getCompressor() const { return compressor_; }
+
+  /**
+   * Get the filters that are applied to each chunk of the data sets
+   * @return filters applied to chunks
+   */
+  const ChunkFilters& getChunkFilters() const { return filters_; }
+
+  /**
+   * Turn on (or off) packing bools eight to a byte
+   *
+   * Packed bool data sets are unsigned bytes holding one bool per
+   * bit rather than the default h5py-compatible enum holding one bool
+   * per byte. They are about eight times smaller on disk, but Python
+   * analyses need to unpack them (e.g. with `numpy.unpackbits` using
+   * the little bit order).
+   *
+   * @param[in] pack true to pack bools into bits
+   */
+  void setPackBools(bool pack) { pack_bools_ = pack; }
+
+  /**
+   * Check if we are packing bools eight to a byte
+   * @return true if new bool data sets are packed
+   */
+  bool getPackBools() const { return pack_bools_; }
+
+  /**
+   * Turn on (or off) storing strings in the flat layout
+   *
+   * Flat strings are stored like a vector of bytes: a `__size__`
+   * data set holding the length of each string and a `data` data set
+   * holding all of their bytes. This avoids HDF5's variable-length
+   * strings which live in the global heap, compress poorly, and
+   * require an allocation for every string read.
+   *
+   * @param[in] flat true to store strings in the flat layout
+   */
+  void setFlatStrings(bool flat) { flat_strings_ = flat; }
+
+  /**
+   * Check if we are storing strings in the flat layout
+   * @return true if new string branches are flat
+   */
+  bool getFlatStrings() const { return flat_strings_; }
+
+  /**
+   * Turn on (or off) recording zone maps
+   *
+   * The zone map of an atomic branch holds the min, max and number of
+   * entries of each chunk that is written. Readers can use it to skip
+   * chunks that cannot pass a cut without reading them. Zone maps are
+   * off by default.
+   *
+   * @param[in] zone_maps true to record zone maps
+   */
+  void setZoneMaps(bool zone_maps) { zone_maps_ = zone_maps; }
+
+  /**
+   * Check if we are recording zone maps
+   * @return true if new arithmetic branches record zone maps
+   */
+  bool getZoneMaps() const { return zone_maps_; }
+
+  /**
+   * Save the zone map of a branch
+   *
+   * The zones are stored as an N x 3 data set of doubles
+   * (min, max, number of entries) at `__zones__/<branch_name>`
+   * within the tree. Data sets that are members of another branch
+   * (e.g. the content of a vector) are not indexed by entry, so
+   * their zone maps are not saved.
+   *
+   * @param[in] branch_name name of branch the zones are for
+   * @param[in] zones min, max and number of entries of each zone in order
+   */
+  void saveZones(const std::string& branch_name,
+                 const std::vector<double>& zones);
+
+  /**
+   * Keep the zone map of a branch to save when we are flushed
+   *
+   * Write buffers only have their whole zone map once they are done,
+   * but they shouldn't write to the file while being destructed.
+   *
+   * @see saveZones
+   *
+   * @param[in] branch_name name of branch the zones are for
+   * @param[in] zones min, max and number of entries of each zone in order
+   */
+  void addZones(const std::string& branch_name, std::vector<double> zones);
+
+  /**
+   * Save a key index of the tree
+   *
+   * The index is stored as an N x n_columns data set of 64-bit integers
+   * at `__index__/<name>` within the tree, chunked by KeyIndex::BLOCK_ROWS
+   * rows. If the index already exists, it is resized and overwritten.
+   *
+   * @see KeyIndex for how the index is laid out and read
+   *
+   * @param[in] name name of the index
+   * @param[in] rows values of each row of the index in order
+   * @param[in] n_columns number of values in each row
+   */
+  void saveIndex(const std::string& name,
+                 const std::vector<std::int64_t>& rows, std::size_t n_columns);
+
+  /**
+   * Keep an error from writing a buffer to report when we are flushed
+   *
+   * Write buffers can't throw the errors of their last writes while
+   * they are being destructed, so they hand them to us instead.
+   * Only the first error is kept.
+   *
+   * @param[in] error exception thrown while writing
+   */
+  void deferError(std::exception_ptr error);
+
   /**
    * Flush the data to disk
    *
-   * We flush all buffers and then flush the file.
+   * We wait for any buffers being compressed or written in the background,
+   * then we save the zone maps we are keeping, update the size of the
+   * tree, and flush the file.
+   *
+   * @throws the first error handed to us by deferError since
+   * we were last flushed
    */
   void flush();
 
   /**
    * increment the number of entries in the HDTree
+   *
+   * @param[in] n number of entries that were saved
    */
-  void increment();
+  void increment(std::size_t n = 1);
 
   /**
    * Get the name of this file
@@ -80,6 +256,29 @@ class Writer {
   HighFive::DataSet createDataSet(const std::string& branch_name,
                                   HighFive::DataType data_type);
 
+  /**
+   * Create a data set that reads its rows from a data set in another file
+   *
+   * The data set is an HDF5 virtual data set, so none of its rows are
+   * stored in our file and it cannot be appended to. The source file
+   * path is stored as it is given, so relative paths are looked for
+   * relative to the current directory and then relative to the
+   * directory of our file when the data set is read.
+   *
+   * @throws HDTreeException if HDF5 fails to create the data set
+   *
+   * @param[in] branch_name name of the new data set
+   * @param[in] data_type type of the rows in the source data set
+   * @param[in] n_rows number of rows in the new data set
+   * @param[in] source {file path, path to data set} of the source
+   * @param[in] source_begin first row of the source to read
+   * @return the new data set
+   */
+  HighFive::DataSet createVirtualDataSet(
+      const std::string& branch_name, const HighFive::DataType& data_type,
+      std::size_t n_rows, const std::pair<std::string, std::string>& source,
+      std::size_t source_begin);
+
   /**
    * Get the number of entries in the file
    */
@@ -104,6 +303,21 @@ class Writer {
   void operator=(const Writer&) = delete;
 
  private:
+  /**
+   * Open the file while holding the HDF5 lock
+   *
+   * The public constructor takes the lock and hands it to us so that
+   * it is held until we return, serializing the creation of the file
+   * with any other threads using HDF5.
+   *
+   * @see Writer for the other parameters
+   *
+   * @param[in] lock HDF5 lock held while constructing
+   */
+  Writer(const std::pair<std::string, std::string>& file_tree_path,
+         bool inplace, int rows_per_chunk, bool shuffle,
+         int compression_level, std::unique_lock<std::recursive_mutex> lock);
+
   /**
    * our highfive file
    */
@@ -120,6 +334,22 @@ class Writer {
   std::size_t entries_;
   /// number of rows to keep in each chunk
   std::size_t rows_per_chunk_;
+  /// the filters applied to each chunk of our data sets
+  ChunkFilters filters_;
+  /// background thread writing full buffers (if writing behind)
+  std::shared_ptr<ThreadPool> flusher_;
+  /// threads compressing chunks (if compressing chunks ourselves)
+  std::shared_ptr<ThreadPool> compressor_;
+  /// pack bools eight to a byte
+  bool pack_bools_{false};
+  /// store strings as lengths and bytes
+  bool flat_strings_{false};
+  /// record the zone maps of arithmetic branches
+  bool zone_maps_{false};
+  /// the zone maps of finished branches waiting to be saved
+  std::vector<std::pair<std::string, std::vector<double>>> zones_;
+  /// the first error writing a buffer that hasn't been reported yet
+  std::exception_ptr error_;
 };
 
 }  // namespace hdtree
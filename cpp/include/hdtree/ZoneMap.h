@@ -0,0 +1,167 @@
+/**
+ * @file ZoneMap.h
+ * Definition of the zone maps used to skip entries that cannot pass a cut
+ */
+#pragma once
+
+#include <limits>
+#include <vector>
+
+#include "hdtree/EntryRange.h"
+
+namespace hdtree {
+
+/**
+ * An interval of values a branch is cut on
+ *
+ * ```cpp
+ * auto high_energy = hdtree::Interval::greater(50.);
+ * auto few_hits = hdtree::Interval::less_equal(10);
+ * ```
+ */
+struct Interval {
+  /// lower bound of the interval
+  double low{-std::numeric_limits<double>::infinity()};
+  /// upper bound of the interval
+  double high{std::numeric_limits<double>::infinity()};
+  /// is the lower bound excluded from the interval?
+  bool low_open{false};
+  /// is the upper bound excluded from the interval?
+  bool high_open{false};
+
+  /// values greater than the input
+  static Interval greater(double x) { return {x, Interval().high, true}; }
+  /// values greater than or equal to the input
+  static Interval greater_equal(double x) { return {x, Interval().high}; }
+  /// values less than the input
+  static Interval less(double x) {
+    return {Interval().low, x, false, true};
+  }
+  /// values less than or equal to the input
+  static Interval less_equal(double x) { return {Interval().low, x}; }
+  /// values equal to the input
+  static Interval equal(double x) { return {x, x}; }
+  /// values in [low, high)
+  static Interval between(double low, double high) {
+    return {low, high, false, true};
+  }
+
+  /**
+   * Could any value within [min, max] be in this interval?
+   * @param[in] min smallest value
+   * @param[in] max largest value
+   * @return true if the ranges overlap
+   */
+  bool overlaps(double min, double max) const {
+    return (low_open ? max > low : max >= low) and
+           (high_open ? min < high : min <= high);
+  }
+};
+
+/**
+ * The zones of entries of a branch and the range of values within them
+ *
+ * When writing, the min, max and number of entries of every chunk
+ * of an arithmetic branch are recorded. A cut on the branch can then
+ * find the entries that may pass it without reading the branch at all.
+ *
+ * ```cpp
+ * for (const auto& entries : tree.select("energy",
+ *                                        hdtree::Interval::greater(50.))) {
+ *   tree.for_each(entries.begin, entries.end, [&]() {
+ *     // only entries in zones holding an energy above 50
+ *   });
+ * }
+ * ```
+ */
+class ZoneMap {
+ public:
+  /**
+   * Build the zone map from what is stored in the file
+   *
+   * @see Writer::saveZones
+   *
+   * @param[in] zones min, max and number of entries of each zone in order
+   */
+  explicit ZoneMap(const std::vector<double>& zones) {
+    std::size_t begin{0};
+    for (std::size_t i{0}; i + 2 < zones.size(); i += 3) {
+      std::size_t end = begin + static_cast<std::size_t>(zones[i + 2]);
+      zones_.push_back({begin, end});
+      min_.push_back(zones[i]);
+      max_.push_back(zones[i + 1]);
+      begin = end;
+    }
+  }
+
+  /// number of zones
+  std::size_t size() const { return zones_.size(); }
+  /// true if there are no zones (the branch has no zone map)
+  bool empty() const { return zones_.empty(); }
+  /// the entries in each zone
+  const std::vector<EntryRange>& zones() const { return zones_; }
+  /// smallest value in each zone
+  const std::vector<double>& min() const { return min_; }
+  /// largest value in each zone
+  const std::vector<double>& max() const { return max_; }
+
+  /**
+   * Find the entries that may pass a cut
+   *
+   * Neighboring zones that may pass are merged into one range.
+   *
+   * @param[in] cut interval the values need to be in
+   * @param[in] within range of entries to look in
+   * @return ranges of entries in zones that overlap the cut
+   */
+  std::vector<EntryRange> select(const Interval& cut,
+                                 const EntryRange& within) const {
+    std::vector<EntryRange> selected;
+    for (std::size_t i{0}; i < zones_.size(); i++) {
+      if (not cut.overlaps(min_[i], max_[i])) continue;
+      EntryRange r{std::max(zones_[i].begin, within.begin),
+                   std::min(zones_[i].end, within.end)};
+      if (r.empty()) continue;
+      if (not selected.empty() and selected.back().end == r.begin) {
+        selected.back().end = r.end;
+      } else {
+        selected.push_back(r);
+      }
+    }
+    return selected;
+  }
+
+ private:
+  /// the entries in each zone
+  std::vector<EntryRange> zones_;
+  /// smallest value in each zone
+  std::vector<double> min_;
+  /// largest value in each zone
+  std::vector<double> max_;
+};
+
+/**
+ * The entries that are in both of the input lists of ranges
+ *
+ * @param[in] a sorted, non-overlapping ranges of entries
+ * @param[in] b sorted, non-overlapping ranges of entries
+ * @return sorted, non-overlapping ranges of entries in both a and b
+ */
+inline std::vector<EntryRange> intersect(const std::vector<EntryRange>& a,
+                                         const std::vector<EntryRange>& b) {
+  std::vector<EntryRange> both;
+  auto i = a.begin();
+  auto j = b.begin();
+  while (i != a.end() and j != b.end()) {
+    EntryRange r{std::max(i->begin, j->begin), std::min(i->end, j->end)};
+    if (not r.empty()) both.push_back(r);
+    if (i->end < j->end) {
+      ++i;
+    } else {
+      ++j;
+    }
+  }
+  return both;
+}
+
+}  // namespace hdtree
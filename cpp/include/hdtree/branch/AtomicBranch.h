@@ -13,85 +13,653 @@ namespace hdtree {
 template <typename AtomicType>
 class Branch<AtomicType, std::enable_if_t<is_atomic_v<AtomicType>>>
     : public AbstractBranch<AtomicType> {
+  /**
+   * Type of the elements in our in-memory buffers
+   *
+   * Bools are buffered as our h5py-compatible enum hdtree::Bool.
+   * This avoids the std::vector<bool> specialization so that the
+   * buffers can be read from and written to disk without translation.
+   */
+  using BufferType =
+      std::conditional_t<std::is_same_v<AtomicType, bool>, Bool, AtomicType>;
+
   class ReadBuffer {
     std::size_t max_len_;
     HighFive::DataSet set_;
-    std::vector<AtomicType> buffer_;
+    std::vector<BufferType> buffer_;
     std::size_t i_file_;
     std::size_t i_memory_;
     std::size_t entries_;
+    /// thread prefetching the next buffer (nullptr if not prefetching)
+    std::shared_ptr<ThreadPool> prefetcher_;
+    /// the next buffer which is filled in the background
+    std::vector<BufferType> next_buffer_;
+    /// handle on the background read into the next buffer
+    std::future<void> next_;
+    /// threads decompressing chunks (nullptr if HDF5 decompresses them)
+    std::shared_ptr<ThreadPool> decompressor_;
+    /// filters applied to the chunks of our data set
+    ChunkFilters filters_;
+    /// number of rows in each chunk of our data set
+    std::size_t chunk_rows_;
+    /// are the bools in our data set packed eight to a byte?
+    bool packed_;
+    /// reusable buffer of the packed bytes read from disk
+    std::vector<std::uint8_t> packed_buffer_;
+    /// sums of our values before the start of each block of max_len_ rows
+    std::vector<AtomicType> block_sums_;
     /**
-     * Load the next chunk of data into memory
+     * Read data from disk into the input buffer
      *
-     * We determine the size of the next chunk from our own
+     * We determine the size of the read from our own
      * maximum and the number of entries in the data set.
-     * We shrink the size of the next chunk depending on how
+     * We shrink the size of the read depending on how
      * many entries are left if we can't grab a whole maximum
      * sized chunk.
      *
-     * We have a compile-time split in order to patch
-     * [a bug](https://github.com/BlueBrain/HighFive/issues/490)
-     * in HighFive that doesn't allow writing of std::vector<bool>
-     * due to the specialization of it **and** to translate
-     * our custom enum hdtree::Bool into bools.
+     * Bools are read as our custom enum hdtree::Bool
+     * or, if they are packed, they are read as bytes
+     * and unpacked. Since our buffer size is a multiple of eight,
+     * every read of packed bools starts at the beginning of a byte.
      *
-     * After reading the next chunk into memory, we update our
-     * indicies by resetting the in-memory index to 0 and moving
-     * the file index by the size of the buffer.
+     * This may be called from the prefetching thread, so it
+     * only touches the buffer and file index it is given.
+     * Only one read is ever in flight, so the packed buffer
+     * can be reused.
      *
-     * @note We assume that the downstream objects using this buffer
-     * know to stop processing before attempting to read passed the
-     * end of the data set. We enforce this with an assertion.
+     * @param[out] buffer in-memory buffer to fill
+     * @param[in] i_file index of first row in data set to read
      */
-    void read_chunk_from_disk() {
+    void read_from_disk(std::vector<BufferType>& buffer, std::size_t i_file) {
       // determine the length we want to request depending
       // on the number of entries left in the file
       std::size_t request_len = this->max_len_;
-      if (request_len + i_file_ > entries_) {
-        request_len = entries_ - i_file_;
+      if (request_len + i_file > entries_) {
+        request_len = entries_ - i_file;
         assert(request_len >= 0);
       }
+      buffer.resize(request_len);
+      if constexpr (std::is_same_v<AtomicType, bool>) {
+        if (packed_) {
+          std::size_t n_bytes = (request_len + 7) / 8;
+          packed_buffer_.resize(n_bytes);
+          if (decompressor_) {
+            read_chunks_from_disk(packed_buffer_.data(), i_file / 8, n_bytes);
+          } else {
+            auto lock = hdf5_lock();
+            this->set_.select({i_file / 8}, {n_bytes}).read(packed_buffer_);
+          }
+          unpack_bools(packed_buffer_.data(), request_len, buffer.data());
+          return;
+        }
+      }
+      if (decompressor_) {
+        read_chunks_from_disk(buffer.data(), i_file, request_len);
+        return;
+      }
+      auto lock = hdf5_lock();
       // load the next chunk into memory
       if constexpr (std::is_same_v<AtomicType, bool>) {
-        /**
-         * compile-time split for bools which
-         * 1. gets around the std::vector<bool> specialization
-         * 2. allows us to translate io::Bool into bools
-         */
-        std::vector<Bool> buff;
-        buff.resize(request_len);
-        this->set_.select({i_file_}, {request_len})
-            .read(buff.data(), create_enum_bool());
-        buffer_.reserve(buff.size());
-        for (const auto& v : buff) buffer_.push_back(v == Bool::TRUE);
+        this->set_.select({i_file}, {request_len})
+            .read(buffer.data(), create_enum_bool());
       } else {
-        this->set_.select({i_file_}, {request_len}).read(buffer_);
+        this->set_.select({i_file}, {request_len}).read(buffer);
+      }
+    }
+
+    /**
+     * Read the raw chunks from disk and decompress them ourselves
+     *
+     * The raw (still compressed) chunks are read directly from the
+     * data set while holding the HDF5 lock and each one is handed
+     * off to the decompression threads as soon as it is read. The
+     * decompression threads write directly into their own section
+     * of the destination, so the only serial work is the reading of the
+     * raw bytes.
+     *
+     * Chunks that were never written to disk are filled with zeros
+     * matching the default fill value of the data set.
+     *
+     * @tparam DiskType type of the elements in the data set
+     * @param[out] dest memory to write request_len elements into
+     * @param[in] i_row index of first row in data set to read,
+     * must be the first row of a chunk
+     * @param[in] request_len number of rows to read
+     */
+    template <typename DiskType>
+    void read_chunks_from_disk(DiskType* dest, std::size_t i_row,
+                               std::size_t request_len) {
+      std::vector<std::future<void>> decompressed;
+      std::exception_ptr read_error;
+      {
+        auto lock = hdf5_lock();
+        for (std::size_t start{i_row}; start < i_row + request_len;
+             start += chunk_rows_) {
+          std::size_t n_rows =
+              std::min(chunk_rows_, i_row + request_len - start);
+          DiskType* chunk_dest = dest + (start - i_row);
+          hsize_t offset[1] = {start};
+          hsize_t raw_size{0};
+          if (H5Dget_chunk_storage_size(set_.getId(), offset, &raw_size) < 0 or
+              raw_size == 0) {
+            std::fill(chunk_dest, chunk_dest + n_rows, DiskType{});
+            continue;
+          }
+          std::vector<char> raw(raw_size);
+          uint32_t filter_mask{0};
+          if (H5Dread_chunk(set_.getId(), H5P_DEFAULT, offset, &filter_mask,
+                            raw.data()) < 0) {
+            read_error = std::make_exception_ptr(HDTreeException(
+                "Unable to read chunk at row " + std::to_string(start) +
+                " directly from disk."));
+            break;
+          }
+          decompressed.push_back(decompressor_->submit(
+              [this, raw = std::move(raw), filter_mask, chunk_dest, n_rows]() {
+                decompress_chunk(raw.data(), raw.size(), filter_mask,
+                                 chunk_dest, chunk_rows_, n_rows,
+                                 sizeof(DiskType), filters_);
+              }));
+        }
+      }
+      // all decompressions need to finish before we leave since they
+      // are writing into the destination
+      for (auto& chunk : decompressed) chunk.wait();
+      if (read_error) std::rethrow_exception(read_error);
+      for (auto& chunk : decompressed) chunk.get();
+    }
+
+    /**
+     * Load the next chunk of data into memory
+     *
+     * If we are prefetching, the next chunk has (probably) already
+     * been read in the background, so we just wait for it to finish
+     * and swap it in as our current buffer. Otherwise, we read
+     * it from disk now.
+     *
+     * After reading the next chunk into memory, we update our
+     * indicies by resetting the in-memory index to 0 and moving
+     * the file index by the size of the buffer.
+     *
+     * Finally, if we are prefetching and there is more data
+     * in the data set, we start reading the chunk after this one
+     * in the background.
+     *
+     * @note We assume that the downstream objects using this buffer
+     * know to stop processing before attempting to read passed the
+     * end of the data set. We enforce this with an assertion.
+     */
+    void read_chunk_from_disk() {
+      if (next_.valid()) {
+        // rethrows any exception from the background read
+        next_.get();
+        std::swap(buffer_, next_buffer_);
+      } else {
+        read_from_disk(buffer_, i_file_);
       }
       // update indices
       i_file_ += buffer_.size();
       i_memory_ = 0;
+      if (prefetcher_ and i_file_ < entries_) {
+        next_ = prefetcher_->submit([this, i_file = i_file_]() {
+          this->read_from_disk(next_buffer_, i_file);
+        });
+      }
     }
 
    public:
-    explicit ReadBuffer(std::size_t max, HighFive::DataSet s)
-        : max_len_{max}, set_{s}, buffer_{}, i_file_{0}, i_memory_{0} {
-      entries_ = this->set_.getDimensions().at(0);
-      this->read_chunk_from_disk();
-      // TODO deduce max_len from chunk size of dataset
+    /**
+     * Define the set we will read from and how we read it
+     *
+     * The buffer size is a multiple of the number of rows
+     * in each chunk of the data set so that our reads are aligned
+     * with the chunks on disk. For packed bools, each row of the
+     * data set holds eight bools.
+     *
+     * We only decompress the chunks ourselves if the reader has
+     * decompression threads, we are reading a fixed-size type, and
+     * the data set only uses filters that we know how to undo.
+     *
+     * @see Reader::getReadBufferRows for how the size is deduced
+     *
+     * @note The HDF5 lock must be held while constructing since
+     * taking (and releasing) the handle to the data set calls into HDF5.
+     *
+     * @param[in] s dataset to read from
+     * @param[in] f reader providing the buffer size and threads
+     */
+    explicit ReadBuffer(HighFive::DataSet s, const Reader& f)
+        : max_len_{f.getReadBufferRows(s)},
+          set_{std::move(s)},
+          buffer_{},
+          i_file_{0},
+          i_memory_{0},
+          prefetcher_{f.getPrefetcher()},
+          chunk_rows_{0},
+          packed_{false} {
+      {
+        auto lock = hdf5_lock();
+        entries_ = this->set_.getDimensions().at(0);
+        if constexpr (std::is_same_v<AtomicType, bool>) {
+          int vers{0};
+          set_.getAttribute(constants::VERS_ATTR_NAME).read(vers);
+          if (vers == PACKED_BOOL_VERSION) {
+            packed_ = true;
+            max_len_ *= 8;
+            set_.getAttribute(constants::SIZE_NAME).read(entries_);
+          }
+        }
+        if constexpr (std::is_arithmetic_v<AtomicType>) {
+          // the raw bytes on disk need to match our in-memory type
+          HighFive::DataType mem_type;
+          if (packed_) {
+            mem_type = HighFive::create_datatype<std::uint8_t>();
+          } else {
+            mem_type = HighFive::create_datatype<BufferType>();
+          }
+          auto filters = deduce_chunk_filters(set_);
+          if (f.getDecompressor() and filters and
+              set_.getDataType() == mem_type) {
+            decompressor_ = f.getDecompressor();
+            filters_ = *filters;
+            chunk_rows_ = deduce_chunk_rows(set_);
+          }
+        }
+      }
+      // the first buffer is read on the first read (or seek) so that
+      // readers starting partway through the data set skip the rows before
+      buffer_.reserve(this->max_len_);
     }
+
+    /**
+     * Wait for any background read to finish and then release
+     * our handle to the data set while holding the HDF5 lock
+     */
+    ~ReadBuffer() {
+      if (next_.valid()) next_.wait();
+      auto lock = hdf5_lock();
+      HighFive::DataSet released{std::move(set_)};
+    }
+
     void read(AtomicType& v) {
       if (i_memory_ == buffer_.size()) this->read_chunk_from_disk();
-      v = buffer_[i_memory_];
+      if constexpr (std::is_same_v<AtomicType, bool>) {
+        v = (buffer_[i_memory_] == Bool::TRUE);
+      } else {
+        v = buffer_[i_memory_];
+      }
       ++i_memory_;
     }
+
+    /**
+     * Read the next n values into the input memory
+     *
+     * Whole runs of values are copied out of our buffer at once,
+     * refilling the buffer from disk as needed.
+     *
+     * @param[out] dest memory to write the n values into
+     * @param[in] n number of values to read
+     */
+    void read(AtomicType* dest, std::size_t n) {
+      while (n > 0) {
+        if (i_memory_ == buffer_.size()) this->read_chunk_from_disk();
+        std::size_t run = std::min(n, buffer_.size() - i_memory_);
+        auto begin = buffer_.begin() + i_memory_;
+        if constexpr (std::is_same_v<AtomicType, bool>) {
+          std::transform(begin, begin + run, dest,
+                         [](Bool b) { return b == Bool::TRUE; });
+        } else {
+          std::copy(begin, begin + run, dest);
+        }
+        i_memory_ += run;
+        dest += run;
+        n -= run;
+      }
+    }
+
+    /**
+     * Move to the input row of the data set
+     *
+     * If the row is in our current buffer (or the buffer being
+     * prefetched), we just move our in-memory index. Otherwise,
+     * we drop any prefetched buffer and read the buffer-sized
+     * block of rows containing the input row. Since the buffer size
+     * is a multiple of the chunk size, this block is aligned with the
+     * chunks on disk and none of the chunks before it are read.
+     *
+     * @throws HDTreeException if the row is past the end of the data set
+     *
+     * @param[in] i_row row that the next read should return
+     */
+    void seek(std::size_t i_row) {
+      if (i_row > entries_) {
+        throw HDTreeException("HDTreeBadSeek: Attempting to seek to row " +
+                              std::to_string(i_row) + " past the end (" +
+                              std::to_string(entries_) + ") of a data set.");
+      }
+      std::size_t buffer_start = i_file_ - buffer_.size();
+      if (i_row < buffer_start or i_row >= i_file_) {
+        if (next_.valid() and i_row >= i_file_ and i_row < i_file_ + max_len_) {
+          // the row is in the buffer we are prefetching
+          this->read_chunk_from_disk();
+        } else {
+          if (next_.valid()) {
+            // drop the prefetched buffer, errors reading it don't matter
+            next_.wait();
+            next_ = std::future<void>();
+          }
+          if (i_row == entries_) {
+            // nothing left to read, just move to the end
+            buffer_.clear();
+            i_file_ = entries_;
+          } else {
+            i_file_ = (i_row / max_len_) * max_len_;
+            this->read_chunk_from_disk();
+          }
+        }
+        buffer_start = i_file_ - buffer_.size();
+      }
+      i_memory_ = i_row - buffer_start;
+    }
+
+    /**
+     * Sum our values in all of the rows before the input row
+     *
+     * This is used to find where the content of an entry starts
+     * in the data set of a variable-length type by summing the
+     * sizes of all of the entries before it.
+     *
+     * The sums of each whole buffer-sized block of rows are cached,
+     * so we only ever read each block from disk once no matter
+     * how often we seek.
+     *
+     * @param[in] i_row row to sum up to (excluding)
+     * @return sum of values in rows [0, i_row)
+     */
+    AtomicType sum_before(std::size_t i_row) {
+      static_assert(std::is_integral_v<AtomicType> and
+                        not std::is_same_v<AtomicType, bool>,
+                    "Only integer data sets can be summed.");
+      if (block_sums_.empty()) block_sums_.push_back(0);
+      std::size_t i_block = i_row / max_len_;
+      std::vector<BufferType> block;
+      while (block_sums_.size() <= i_block) {
+        read_from_disk(block, (block_sums_.size() - 1) * max_len_);
+        block_sums_.push_back(
+            std::accumulate(block.begin(), block.end(), block_sums_.back()));
+      }
+      std::size_t block_start = i_block * max_len_;
+      if (i_row == block_start) return block_sums_[i_block];
+      const std::vector<BufferType>* rows = &buffer_;
+      if (buffer_.empty() or block_start != i_file_ - buffer_.size()) {
+        read_from_disk(block, block_start);
+        rows = &block;
+      }
+      return std::accumulate(rows->begin(),
+                             rows->begin() + (i_row - block_start),
+                             block_sums_[i_block]);
+    }
+
+    /**
+     * View the next n values in place
+     *
+     * If the n values are all within our current buffer, we point
+     * directly into it. Otherwise, they are copied into the scratch.
+     *
+     * @param[in] n number of values to view
+     * @param[in,out] scratch buffer to copy into if we can't point
+     * directly into our buffer
+     * @return pointer to the first of the n values, valid until the
+     * next read
+     */
+    const BufferType* view(std::size_t n, std::vector<AtomicType>& scratch) {
+      if (n > 0 and i_memory_ == buffer_.size()) this->read_chunk_from_disk();
+      if (i_memory_ + n <= buffer_.size()) {
+        const BufferType* begin = buffer_.data() + i_memory_;
+        i_memory_ += n;
+        return begin;
+      }
+      scratch.resize(n);
+      read(scratch.data(), n);
+      return scratch.data();
+    }
   };
   std::unique_ptr<ReadBuffer> read_buffer_;
 
   class WriteBuffer {
     std::size_t max_len_;
     HighFive::DataSet set_;
-    std::vector<AtomicType> buffer_;
+    std::vector<BufferType> buffer_;
     std::size_t i_file_;
+    /// thread writing full buffers in the background (nullptr if not)
+    std::shared_ptr<ThreadPool> flusher_;
+    /// threads compressing chunks ourselves (nullptr if not)
+    std::shared_ptr<ThreadPool> compressor_;
+    /// filters to apply when compressing chunks ourselves
+    ChunkFilters filters_;
+    /// handles on the background writes that have not been checked yet
+    std::deque<std::future<void>> pending_;
+    /// are we packing bools eight to a byte?
+    bool packed_;
+    /// reusable buffer of the packed bytes to write to disk
+    std::vector<std::uint8_t> packed_buffer_;
+    /// writer the data set is in, saving our zone map and last errors
+    Writer& writer_;
+    /// are we recording a zone map?
+    bool zone_maps_;
+    /// name of the branch we are writing, for saving our zone map
+    std::string name_;
+    /// the min, max and number of entries of each buffer we have flushed
+    std::vector<double> zones_;
+
+    /**
+     * Record the min, max and size of the buffer in our zone map
+     *
+     * NaNs are skipped since they fail every comparison, so a zone
+     * holding only NaNs has an empty range and never passes a cut.
+     * The bounds of 64-bit integers beyond 2^53 are rounded outward
+     * since they may not be exactly representable as doubles.
+     */
+    void record_zone() {
+      double lo{std::numeric_limits<double>::infinity()};
+      double hi{-std::numeric_limits<double>::infinity()};
+      for (const auto& val : buffer_) {
+        double v = static_cast<double>(val);
+        lo = v < lo ? v : lo;
+        hi = v > hi ? v : hi;
+      }
+      if constexpr (std::is_integral_v<AtomicType> and
+                    sizeof(AtomicType) > 4) {
+        const double exact{9007199254740992.};
+        if (lo < -exact) {
+          lo = std::nextafter(lo, -std::numeric_limits<double>::infinity());
+        }
+        if (hi > exact) {
+          hi = std::nextafter(hi, std::numeric_limits<double>::infinity());
+        }
+      }
+      zones_.insert(zones_.end(),
+                    {lo, hi, static_cast<double>(buffer_.size())});
+    }
+
+    /**
+     * Make sure the data set on disk is at least the input size
+     *
+     * Background writes may finish out of order, so we never
+     * shrink the data set.
+     *
+     * If we are packing bools, we also keep the number of bools
+     * that have been written in an attribute of the data set since
+     * the last byte may only be partially filled.
+     *
+     * @param[in] new_extent minimum size of data set in rows
+     * @param[in] new_size minimum number of entries written
+     */
+    void extend(std::size_t new_extent, std::size_t new_size) {
+      // throws if not created yet
+      if (this->set_.getDimensions().at(0) < new_extent) {
+        this->set_.resize({new_extent});
+      }
+      if (packed_) {
+        auto size_attr = this->set_.getAttribute(constants::SIZE_NAME);
+        std::size_t written{0};
+        size_attr.read(written);
+        if (written < new_size) size_attr.write(new_size);
+      }
+    }
+
+    /**
+     * Compress the input chunk ourselves and write it directly
+     * into the data set
+     *
+     * The compression is done without holding the HDF5 lock,
+     * so many chunks can be compressed at once.
+     *
+     * @throws HDTreeException if HDF5 fails to write the chunk
+     *
+     * @tparam DiskType type of the elements in the data set
+     * @param[in] chunk whole chunk of data to write
+     * @param[in] i_row index of first row of the chunk in the data set
+     * @param[in] n_rows number of rows in the chunk holding real data
+     * @param[in] n_entries number of entries held by the chunk
+     */
+    template <typename DiskType>
+    void write_chunk(const std::vector<DiskType>& chunk, std::size_t i_row,
+                     std::size_t n_rows, std::size_t n_entries) {
+      std::vector<char> compressed =
+          compress_chunk(chunk.data(), chunk.size() * sizeof(DiskType),
+                         sizeof(DiskType), filters_);
+      auto lock = hdf5_lock();
+      extend(i_row + n_rows, i_row * (packed_ ? 8 : 1) + n_entries);
+      hsize_t offset[1] = {i_row};
+      if (H5Dwrite_chunk(this->set_.getId(), H5P_DEFAULT, 0, offset,
+                         compressed.size(), compressed.data()) < 0) {
+        throw HDTreeException("HDTreeCompression: Unable to write chunk at " +
+                              std::to_string(i_row) + " directly.");
+      }
+    }
+
+    /**
+     * Compress the input buffer ourselves and write it directly
+     * into the data set as a single chunk
+     *
+     * HDF5 stores partial chunks at the end of a data set as whole chunks,
+     * so we pad the buffer with zeros up to a whole chunk before
+     * compressing it. The extent of the data set is still only
+     * extended to cover the real data.
+     *
+     * Packed bools are packed into a chunk of bytes
+     * before being compressed.
+     *
+     * @param[in] buffer data to write, at most a single chunk
+     * @param[in] i_file index of the first entry of the buffer
+     */
+    void compress_to_disk(const std::vector<BufferType>& buffer,
+                          std::size_t i_file) {
+      if constexpr (std::is_same_v<AtomicType, bool>) {
+        if (packed_) {
+          std::vector<std::uint8_t> chunk(this->max_len_ / 8, 0);
+          pack_bools(buffer.data(), buffer.size(), chunk.data());
+          write_chunk(chunk, i_file / 8, (buffer.size() + 7) / 8,
+                      buffer.size());
+          return;
+        }
+      }
+      std::vector<BufferType> chunk(this->max_len_, BufferType{});
+      std::copy(buffer.begin(), buffer.end(), chunk.begin());
+      write_chunk(chunk, i_file, buffer.size(), buffer.size());
+    }
+
+    /**
+     * Write the input buffer into the data set on disk
+     *
+     * We determine the new extent of the dataset given how many
+     * elements are in the buffer, then we resize the dataset
+     * that is on disk to this new extent.
+     *
+     * Then, we copy the buffer into the DataSet on disk.
+     * Bools are already in our custom enum hdtree::Bool
+     * which mimics the serialization behavior of the bool type
+     * understandable by h5py. If we are packing bools, they
+     * are packed into bytes first.
+     *
+     * This may be called from the write-behind thread, so it
+     * only touches the buffer and file index it is given.
+     * Only one write is ever in flight, so the packed buffer
+     * can be reused.
+     *
+     * @throws HighFive::DataSetException if unable to extend or
+     * write to the DataSet.
+     *
+     * @param[in] buffer data to write
+     * @param[in] i_file index in data set to start writing at
+     */
+    void write_to_disk(const std::vector<BufferType>& buffer,
+                       std::size_t i_file) {
+      if constexpr (std::is_same_v<AtomicType, bool>) {
+        if (packed_) {
+          // our buffer is a multiple of eight long so we start on a byte
+          std::size_t n_bytes = (buffer.size() + 7) / 8;
+          packed_buffer_.resize(n_bytes);
+          pack_bools(buffer.data(), buffer.size(), packed_buffer_.data());
+          auto lock = hdf5_lock();
+          extend(i_file / 8 + n_bytes, i_file + buffer.size());
+          this->set_.select({i_file / 8}, {n_bytes}).write(packed_buffer_);
+          return;
+        }
+      }
+      auto lock = hdf5_lock();
+      extend(i_file + buffer.size(), i_file + buffer.size());
+      this->set_.select({i_file}, {buffer.size()}).write(buffer);
+    }
+
+    /**
+     * Check on the background writes that have finished
+     *
+     * Calling std::future::get rethrows any exception that was
+     * thrown while writing in the background on this thread.
+     *
+     * @param[in] wait_for_all wait for all of the pending writes to finish
+     */
+    void check_pending(bool wait_for_all) {
+      while (not pending_.empty()) {
+        auto& next = pending_.front();
+        if (not wait_for_all and next.wait_for(std::chrono::seconds(0)) !=
+                                     std::future_status::ready)
+          break;
+        // move out before get so we can pop even if it throws
+        auto finished{std::move(next)};
+        pending_.pop_front();
+        finished.get();
+      }
+    }
+
+    /// signature of the functions that write a buffer to disk
+    using WriteMethod = void (WriteBuffer::*)(const std::vector<BufferType>&,
+                                              std::size_t);
+
+    /**
+     * Move our buffer into a task for the input pool of threads
+     *
+     * The task writes the buffer to disk with the input method.
+     * We leave ourselves a fresh buffer and move the file index forward
+     * so we can keep saving while the task runs.
+     *
+     * @param[in] pool threads to run the task on
+     * @param[in] write method to call for writing the buffer to disk
+     */
+    void hand_off(ThreadPool& pool, WriteMethod write) {
+      check_pending(false);
+      std::size_t n = buffer_.size();
+      pending_.push_back(pool.submit(
+          [this, write, buffer = std::move(buffer_), i_file = i_file_]() {
+            (this->*write)(buffer, i_file);
+          }));
+      i_file_ += n;
+      buffer_ = std::vector<BufferType>();
+      buffer_.reserve(this->max_len_);
+    }
+
     /**
      * Flush our in-memory buffer onto disk
      *
@@ -102,79 +670,151 @@ class Branch<AtomicType, std::enable_if_t<is_atomic_v<AtomicType>>>
      * Writer::~Writer is called which calls all Buffers to flush
      * in order to avoid data loss.
      *
-     * We determine the new extent of the dataset given how many
-     * elements are in the buffer, then we resize the dataset
-     * that is on disk to this new extent.
+     * If we are compressing chunks ourselves (and our type has a fixed
+     * size), we hand the buffer off to the compression threads
+     * which compress it and write it directly as a chunk. Since
+     * our buffer is exactly one chunk long, the chunks we write line
+     * up with the chunks of the data set.
      *
-     * Then, we copy the buffer into the DataSet on disk using
-     * a compile-time choice that handles the std::vector<bool>
-     * specialization
-     * [bug in HighFive](https://github.com/BlueBrain/HighFive/issues/490).
-     * *and* translates bools into our custom enum hdtree::Bool
-     * which mimics the serialization behavior of the bool type
-     * understandable by h5py.
+     * If we are writing behind, we hand the full buffer off to the
+     * background thread. The background thread runs the writes in the
+     * order they are submitted, so the data set is always extended in
+     * order. Otherwise, we write the buffer to disk now.
      *
-     * Finally, we update the file index, clear the buffer,
-     * and re-reserve the maximum length of the buffer to prepare
-     * for another chunk of data.
+     * Finally, we update the file index and clear the buffer
+     * to prepare for another chunk of data.
      *
-     * @throws HighFive::DataSetException if unable to extend or
-     * write to the DataSet.
+     * Before any of that, we record the zone of the buffer in
+     * our zone map if we are keeping one.
      */
     void flush() {
       if (buffer_.size() == 0) return;
-      std::size_t new_extent = i_file_ + buffer_.size();
-      // throws if not created yet
-      if (this->set_.getDimensions().at(0) < new_extent) {
-        this->set_.resize({new_extent});
+      if constexpr (std::is_arithmetic_v<AtomicType> and
+                    not std::is_same_v<AtomicType, bool>) {
+        if (zone_maps_) record_zone();
       }
-      if constexpr (std::is_same_v<AtomicType, bool>) {
-        // handle bool specialization
-        std::vector<Bool> buff;
-        buff.reserve(buffer_.size());
-        for (const auto& v : buffer_)
-          buff.push_back(v ? Bool::TRUE : Bool::FALSE);
-        this->set_.select({i_file_}, {buffer_.size()}).write(buff);
+      if constexpr (std::is_arithmetic_v<AtomicType>) {
+        if (compressor_) {
+          hand_off(*compressor_, &WriteBuffer::compress_to_disk);
+          return;
+        }
+      }
+      if (flusher_) {
+        hand_off(*flusher_, &WriteBuffer::write_to_disk);
       } else {
-        this->set_.select({i_file_}, {buffer_.size()}).write(buffer_);
+        write_to_disk(buffer_, i_file_);
+        i_file_ += buffer_.size();
+        buffer_.clear();
       }
-      i_file_ += buffer_.size();
-      buffer_.clear();
-      buffer_.reserve(this->max_len_);
     }
 
    public:
     /**
      * Define the buffer size and the set we will write to
      *
+     * The buffer is exactly as long as a chunk of the data set
+     * so that every flush (besides the last one) writes one whole chunk.
+     * If we are packing bools, a chunk of bytes holds eight times
+     * as many bools.
+     *
      * We also use std::vector::reserve to let the memory
      * handler know the size of our buffer. This can help
      * us avoid unnecessary copying and reallocation while
      * using std::vector::push_back to insert elements into
      * the vector.
      *
-     * @param[in] max buffer size
+     * Zone maps are only kept for arithmetic types other than bool.
+     *
      * @param[in] s dataset to write to
+     * @param[in] f writer the data set is in, holding the chunk size and
+     * the threads to write or compress in the background
+     * @param[in] name name of the branch we are writing
      */
-    explicit WriteBuffer(std::size_t max, HighFive::DataSet s)
-        : max_len_{max}, set_{s}, buffer_{}, i_file_{0} {
+    WriteBuffer(HighFive::DataSet s, Writer& f, const std::string& name)
+        : max_len_{static_cast<std::size_t>(f.getRowsPerChunk())},
+          set_{s},
+          buffer_{},
+          i_file_{0},
+          flusher_{f.getFlusher()},
+          compressor_{f.getCompressor()},
+          filters_{f.getChunkFilters()},
+          packed_{std::is_same_v<AtomicType, bool> and f.getPackBools()},
+          writer_{f},
+          zone_maps_{false},
+          name_{name} {
+      if (packed_) max_len_ *= 8;
+      if constexpr (std::is_arithmetic_v<AtomicType> and
+                    not std::is_same_v<AtomicType, bool>) {
+        zone_maps_ = f.getZoneMaps();
+      }
       buffer_.reserve(this->max_len_);
     }
 
-    // flush before deleting
-    ~WriteBuffer() { flush(); }
+    /**
+     * flush before deleting
+     *
+     * We wait for all of the background writes to finish and then
+     * release our handle to the data set while holding the HDF5 lock.
+     * Our zone map is complete now, so it is handed to the writer
+     * which saves it when it is flushed (see Writer::addZones).
+     *
+     * We can't throw while being destructed, so the first error of
+     * our last writes is handed to the writer which throws it when
+     * it is flushed (see Writer::deferError).
+     */
+    ~WriteBuffer() {
+      try {
+        flush();
+        check_pending(true);
+      } catch (...) {
+        writer_.deferError(std::current_exception());
+      }
+      // the writes left after an error still refer to us
+      for (auto& write : pending_) write.wait();
+      if (zone_maps_) writer_.addZones(name_, std::move(zones_));
+      auto lock = hdf5_lock();
+      HighFive::DataSet released{std::move(set_)};
+    }
 
     /**
      * Put the new value into the buffer
      *
-     * If the buffer goes over the maximum length of the buffer,
+     * If the buffer reaches the maximum length of the buffer,
      * then we call Buffer::flush
      *
      * @param[in] val data to append to the dataset
      */
     void save(const AtomicType& val) {
-      buffer_.push_back(val);
-      if (buffer_.size() > this->max_len_) flush();
+      if constexpr (std::is_same_v<AtomicType, bool>) {
+        buffer_.push_back(val ? Bool::TRUE : Bool::FALSE);
+      } else {
+        buffer_.push_back(val);
+      }
+      if (buffer_.size() == this->max_len_) flush();
+    }
+
+    /**
+     * Put the n input values into the buffer
+     *
+     * Whole runs of values are copied into our buffer at once,
+     * flushing it each time it is filled.
+     *
+     * @param[in] src pointer to the values to append to the dataset
+     * @param[in] n number of values to append
+     */
+    void save(const AtomicType* src, std::size_t n) {
+      while (n > 0) {
+        std::size_t run = std::min(n, this->max_len_ - buffer_.size());
+        if constexpr (std::is_same_v<AtomicType, bool>) {
+          std::transform(src, src + run, std::back_inserter(buffer_),
+                         [](bool b) { return b ? Bool::TRUE : Bool::FALSE; });
+        } else {
+          buffer_.insert(buffer_.end(), src, src + run);
+        }
+        if (buffer_.size() == this->max_len_) flush();
+        src += run;
+        n -= run;
+      }
     }
   };
 
@@ -191,18 +831,37 @@ class Branch<AtomicType, std::enable_if_t<is_atomic_v<AtomicType>>>
   explicit Branch(const std::string& branch_name, AtomicType* handle = nullptr)
       : AbstractBranch<AtomicType>(branch_name, handle) {}
 
+  /**
+   * Attach to the input reader
+   *
+   * Strings stored in the flat layout are in a group rather
+   * than a data set, so we read them through our flat branches.
+   *
+   * @param[in] f Reader to attach to
+   */
   void attach(Reader& f) final override try {
-    // deletes old read_buffer_ if there was one already constructed
-    read_buffer_ =
-        std::make_unique<ReadBuffer>(10000, f.getDataSet(this->name_));
+    if constexpr (std::is_same_v<AtomicType, std::string>) {
+      if (f.getH5ObjectType(this->name_) == HighFive::ObjectType::Group) {
+        read_buffer_.reset();
+        make_flat();
+        flat_size_->attach(f);
+        flat_data_->attach(f);
+        return;
+      }
+    }
+    // deletes old read_buffer_ if there was one already constructed,
+    // which waits on its prefetch so it can't hold the lock
+    read_buffer_.reset();
+    // other threads may be using HDF5 (e.g. prefetching for other branches)
+    // so the handle to the data set is only copied while holding the lock
+    auto lock = hdf5_lock();
+    read_buffer_ = std::make_unique<ReadBuffer>(f.getDataSet(this->name_), f);
   } catch (const HighFive::DataSetException& e) {
     // an exception was thrown when we tried to `get` the dataset by name
-    std::stringstream msg, help;
-    msg << "HDTreeBadType: Branch at " << this->name_
-        << " could not be accessed.";
-    help << "Check that this branch exists in your HDTree.\n"
-            "    H5 Error: " << e.what();
-    throw HDTreeException(msg.str(), help.str());
+    throw not_accessible(e);
+  } catch (const HighFive::GroupException& e) {
+    // an exception was thrown when we tried to find a string by name
+    throw not_accessible(e);
   }
 
   /**
@@ -211,10 +870,114 @@ class Branch<AtomicType, std::enable_if_t<is_atomic_v<AtomicType>>>
    * @see Reader::load for how we read data from
    * the file at the input branch_name to our handle.
    *
+   * Flat strings read their length and then copy
+   * that many bytes directly into the string.
+   *
    * @param[in] f Reader to load from
    */
   void load() final override {
-    if (read_buffer_) read_buffer_->read(*(this->handle_));
+    if (read_buffer_) {
+      read_buffer_->read(*(this->handle_));
+      return;
+    }
+    if constexpr (std::is_same_v<AtomicType, std::string>) {
+      if (flat_size_) {
+        flat_size_->load();
+        this->handle_->resize(flat_size_->get());
+        flat_data_->load(reinterpret_cast<std::uint8_t*>(this->handle_->data()),
+                         this->handle_->size());
+      }
+    }
+  }
+
+  /**
+   * Load the next n values of this branch into the input memory
+   *
+   * This skips the handle entirely and copies whole runs of values
+   * out of the read buffer at once, so it is much faster than
+   * calling load n times for containers of atomic types.
+   *
+   * @throws HDTreeException if we are not reading
+   *
+   * @param[out] dest memory to write the n values into
+   * @param[in] n number of values to load
+   */
+  void load(AtomicType* dest, std::size_t n) {
+    if (read_buffer_) {
+      read_buffer_->read(dest, n);
+      return;
+    }
+    if constexpr (std::is_same_v<AtomicType, std::string>) {
+      if (flat_size_) {
+        for (std::size_t i{0}; i < n; i++) {
+          flat_size_->load();
+          dest[i].resize(flat_size_->get());
+          flat_data_->load(reinterpret_cast<std::uint8_t*>(dest[i].data()),
+                           dest[i].size());
+        }
+        return;
+      }
+    }
+    throw HDTreeException(
+        "Attempting to load values of branch " + this->name_ +
+            " without reading.",
+        "Only branches retrieved with `tree.get` from a tree that is "
+        "reading an input file have values to load.");
+  }
+
+  /**
+   * Move to the input entry so that the next load reads it
+   *
+   * Flat strings find the start of the entry's bytes by summing
+   * the lengths of the strings before it.
+   *
+   * @param[in] i_entry entry to move to
+   */
+  void seek(std::size_t i_entry) final override {
+    if (read_buffer_) {
+      read_buffer_->seek(i_entry);
+      return;
+    }
+    if constexpr (std::is_same_v<AtomicType, std::string>) {
+      if (flat_size_) {
+        flat_data_->seek(flat_size_->sum_before(i_entry));
+        flat_size_->seek(i_entry);
+      }
+    }
+  }
+
+  /**
+   * Sum the values of this branch in all entries before the input entry
+   *
+   * @see ReadBuffer::sum_before
+   *
+   * @param[in] i_entry entry to sum up to (excluding)
+   * @return sum of the values, zero if we are not reading
+   */
+  AtomicType sum_before(std::size_t i_entry) {
+    if (not read_buffer_) return 0;
+    return read_buffer_->sum_before(i_entry);
+  }
+
+  /**
+   * View the next n values of this branch without copying them
+   *
+   * This is only available for arithmetic types besides bool
+   * since bools are buffered as a different type.
+   *
+   * @see Branch<View<T>> for where this is used
+   *
+   * @param[in] n number of values to view
+   * @param[in,out] scratch buffer to copy into if the values span
+   * a refill of our read buffer
+   * @return pointer to the first of the n values, valid until
+   * the next load
+   */
+  const AtomicType* view(std::size_t n, std::vector<AtomicType>& scratch) {
+    static_assert(std::is_same_v<AtomicType, BufferType>,
+                  "Only types that are buffered as-is can be viewed.");
+    if (not read_buffer_) return nullptr;
+    return read_buffer_->view(n, scratch);
   }
 
   /**
@@ -223,10 +986,74 @@ class Branch<AtomicType, std::enable_if_t<is_atomic_v<AtomicType>>>
    * @see io::Writer::save for how we write data to
    * the file at the input branch_name from our handle.
    *
+   * Flat strings save their length and then copy
+   * their bytes directly into the write buffer.
+   *
    * @param[in] f io::Writer to save to
    */
   void save() final override {
-    if (write_buffer_) write_buffer_->save(*(this->handle_));
+    if (write_buffer_) {
+      write_buffer_->save(*(this->handle_));
+      return;
+    }
+    if constexpr (std::is_same_v<AtomicType, std::string>) {
+      // flat strings that are only read have nowhere to save
+      if (flat_size_ and flat_size_->saving()) {
+        flat_size_->update(this->handle_->size());
+        flat_size_->save();
+        flat_data_->save(
+            reinterpret_cast<const std::uint8_t*>(this->handle_->data()),
+            this->handle_->size());
+      }
+    }
+  }
+
+  /**
+   * Save the n input values to this branch
+   *
+   * This skips the handle entirely and copies whole runs of values
+   * into the write buffer at once.
+   *
+   * @throws HDTreeException if we are not writing
+   *
+   * @param[in] src pointer to the n values to save
+   * @param[in] n number of values to save
+   */
+  void save(const AtomicType* src, std::size_t n) {
+    if (write_buffer_) {
+      write_buffer_->save(src, n);
+      return;
+    }
+    if constexpr (std::is_same_v<AtomicType, std::string>) {
+      if (flat_size_ and flat_size_->saving()) {
+        for (std::size_t i{0}; i < n; i++) {
+          flat_size_->update(src[i].size());
+          flat_size_->save();
+          flat_data_->save(
+              reinterpret_cast<const std::uint8_t*>(src[i].data()),
+              src[i].size());
+        }
+        return;
+      }
+    }
+    throw HDTreeException(
+        "Attempting to save values of branch " + this->name_ +
+            " without writing.",
+        "Only branches made with `tree.branch` (or retrieved with "
+        "`tree.get(name, true)`) on a tree that is writing an output file "
+        "have somewhere to save values.");
+  }
+
+  /**
+   * Check if we are saving values to an output file
+   *
+   * @return true if we are attached to a writer
+   */
+  bool saving() const {
+    if constexpr (std::is_same_v<AtomicType, std::string>) {
+      if (flat_size_ and flat_size_->saving()) return true;
+    }
+    return write_buffer_ != nullptr;
   }
 
   /**
@@ -234,20 +1061,47 @@ class Branch<AtomicType, std::enable_if_t<is_atomic_v<AtomicType>>>
    *
    * The atomic types are translated into H5 DataSets in Writer::save
    * where the types are persisted as well.
+   *
+   * The exception are strings when the writer is using the flat string
+   * layout. Like a vector, they are a group holding the length of each
+   * string and all of the bytes of the strings serially.
    */
   void attach(Writer& f) final override try {
+    auto lock = hdf5_lock();
+    if constexpr (std::is_same_v<AtomicType, std::string>) {
+      if (f.getFlatStrings()) {
+        write_buffer_.reset();
+        f.structure(this->name_,
+                    {boost::core::demangle(typeid(AtomicType).name()),
+                     FLAT_STRING_VERSION});
+        make_flat();
+        flat_size_->attach(f);
+        flat_data_->attach(f);
+        return;
+      }
+    }
     HighFive::DataType t;
+    int vers{0};
+    bool packed{false};
     if constexpr (std::is_same_v<AtomicType, bool>) {
-      t = create_enum_bool();
+      packed = f.getPackBools();
+      if (packed) {
+        t = HighFive::AtomicType<std::uint8_t>();
+        vers = PACKED_BOOL_VERSION;
+      } else {
+        t = create_enum_bool();
+      }
     } else {
       t = HighFive::AtomicType<AtomicType>();
     }
     auto ds = f.createDataSet(this->name_, t);
     ds.createAttribute(constants::TYPE_ATTR_NAME,
                        boost::core::demangle(typeid(AtomicType).name()));
-    ds.createAttribute(constants::VERS_ATTR_NAME, 0);
+    ds.createAttribute(constants::VERS_ATTR_NAME, vers);
+    // packed bools need to know how many bits of the last byte are used
+    if (packed) ds.createAttribute(constants::SIZE_NAME, std::size_t{0});
     // flush and deletes old buffer if it exists
-    write_buffer_ = std::make_unique<WriteBuffer>(f.getRowsPerChunk(), ds);
+    write_buffer_ = std::make_unique<WriteBuffer>(ds, f, this->name_);
   } catch (const HighFive::DataSetException& e) {
     // an exception was thrown when we tried to create the dataset by name
     std::stringstream msg, help;
@@ -257,6 +1111,42 @@ class Branch<AtomicType, std::enable_if_t<is_atomic_v<AtomicType>>>
             "      H5 Error:  " << e.what();
     throw HDTreeException(msg.str(), help.str());
   }
+
+ private:
+  /**
+   * Make the exception for a branch that we couldn't find in the input
+   *
+   * @param[in] e error from HighFive when looking up the branch by name
+   * @return exception to throw
+   */
+  HDTreeException not_accessible(const HighFive::Exception& e) const {
+    std::stringstream msg, help;
+    msg << "HDTreeBadType: Branch at " << this->name_
+        << " could not be accessed.";
+    help << "Check that this branch exists in your HDTree.\n"
+            "    H5 Error: " << e.what();
+    return HDTreeException(msg.str(), help.str());
+  }
+
+  /**
+   * Create the branches holding the flat layout of strings
+   *
+   * The same branches are used for reading and writing if
+   * both the input and output use the flat layout.
+   */
+  void make_flat() {
+    if (flat_size_) return;
+    flat_size_ = std::make_unique<Branch<std::size_t>>(
+        this->name_ + "/" + constants::SIZE_NAME);
+    flat_data_ =
+        std::make_unique<Branch<std::uint8_t>>(this->name_ + "/data");
+  }
+
+ private:
+  /// the lengths of the strings (only used for flat strings)
+  std::unique_ptr<Branch<std::size_t>> flat_size_;
+  /// the bytes of all the strings (only used for flat strings)
+  std::unique_ptr<Branch<std::uint8_t>> flat_data_;
 };  // Branch<AtomicType>
 
 }  // namespace hdtree
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <limits>
+#include <optional>
+#include <unordered_map>
+
+#include "hdtree/Categorical.h"
+
+namespace hdtree {
+
+/**
+ * Our wrapper around hdtree::Categorical
+ *
+ * We create two child branches. The `dictionary` holds each distinct
+ * value once in the order that they were first saved and the `codes`
+ * holds the index into the dictionary for each entry. Since codes are
+ * handed out in the order the values are first seen, the dictionary
+ * only ever grows at its end as we save.
+ *
+ * When loading, we read the whole dictionary into memory up front
+ * (it is small by construction) and then only read the codes for each
+ * entry, pointing the in-memory categorical into our dictionary.
+ *
+ * @tparam T atomic type of the values
+ * @tparam Code unsigned integer type of the codes
+ */
+template <typename T, typename Code>
+class Branch<Categorical<T, Code>>
+    : public AbstractBranch<Categorical<T, Code>> {
+ public:
+  /**
+   * We create the two child branches for the dictionary and the codes
+   *
+   * @param[in] branch_name full in-file branch_name to set holding this data
+   * @param[in] handle pointer to object already constructed (optional)
+   */
+  explicit Branch(const std::string& branch_name,
+                  Categorical<T, Code>* handle = nullptr)
+      : AbstractBranch<Categorical<T, Code>>(branch_name, handle),
+        dictionary_{branch_name + "/dictionary"},
+        codes_{branch_name + "/codes"} {}
+
+  /**
+   * Attach to the input reader, loading the whole dictionary
+   *
+   * We deduce the number of values in the dictionary from the
+   * extent of its data set (or of its size data set if the values
+   * are strings stored in the flat layout).
+   *
+   * @param[in] f Reader to load from
+   */
+  void attach(Reader& f) final override {
+    this->load_type_ = f.type(this->name_);
+    dictionary_.attach(f);
+    codes_.attach(f);
+    std::string dict_name{this->name_ + "/dictionary"};
+    std::size_t n_values{0};
+    {
+      auto lock = hdf5_lock();
+      if (f.getH5ObjectType(dict_name) == HighFive::ObjectType::Group)
+        dict_name += "/" + constants::SIZE_NAME;
+      n_values = f.getDataSet(dict_name).getDimensions().at(0);
+    }
+    auto values = std::make_shared<std::vector<T>>();
+    values->reserve(n_values);
+    for (std::size_t i_value{0}; i_value < n_values; i_value++) {
+      dictionary_.load();
+      values->push_back(dictionary_.get());
+    }
+    decoded_ = values;
+  }
+
+  /**
+   * Load the code for the next entry
+   *
+   * The in-memory categorical is pointed at our dictionary,
+   * so the value is not copied.
+   *
+   * @throws HDTreeException if the code is not in the dictionary
+   */
+  void load() final override {
+    codes_.load();
+    Code code = codes_.get();
+    if (not decoded_ or code >= decoded_->size()) {
+      throw HDTreeException("HDTreeBadCode: Categorical branch " +
+                                this->name_ + " has a code " +
+                                std::to_string(code) +
+                                " that is not in its dictionary.",
+                            "The dictionary and codes of this branch are "
+                            "out of sync, the file may be corrupted.");
+    }
+    this->handle_->code_ = code;
+    this->handle_->dictionary_ = decoded_;
+  }
+
+  /**
+   * Move to the input entry
+   *
+   * The dictionary is already in memory, so we only move the codes.
+   *
+   * @param[in] i_entry entry to move to
+   */
+  void seek(std::size_t i_entry) final override { codes_.seek(i_entry); }
+
+  /**
+   * Persist the structure of the categorical and attach the children
+   *
+   * @param[in] f Writer to save to
+   */
+  void attach(Writer& f) final override {
+    f.structure(this->name_, this->save_type_);
+    dictionary_.attach(f);
+    codes_.attach(f);
+  }
+
+  /**
+   * Save the code for the current value
+   *
+   * If the value has not been seen before, we give it the next
+   * code and save it into the dictionary.
+   *
+   * @throws HDTreeException if there are more distinct values than
+   * can be represented by the code type
+   */
+  void save() final override {
+    const T& value = this->handle_->value();
+    auto it = encoding_.find(value);
+    Code code;
+    if (it == encoding_.end()) {
+      if (encoding_.size() > std::numeric_limits<Code>::max()) {
+        throw HDTreeException(
+            "HDTreeBadCode: Categorical branch " + this->name_ +
+                " has more distinct values than its code type can hold.",
+            "Use a wider code type for this branch, for example "
+            "hdtree::Categorical<T, std::uint32_t>.");
+      }
+      code = static_cast<Code>(encoding_.size());
+      encoding_.emplace(value, code);
+      dictionary_.update(value);
+      dictionary_.save();
+    } else {
+      code = it->second;
+    }
+    codes_.update(code);
+    codes_.save();
+  }
+
+  /**
+   * Get the code of the input value
+   *
+   * This is helpful for comparing the codes of entries to a specific
+   * value without looking up the value of every entry.
+   *
+   * We look in the dictionary we loaded if we are reading and the
+   * values we have saved so far otherwise.
+   *
+   * @param[in] value value to look up
+   * @return code of the value, std::nullopt if it is not in the dictionary
+   */
+  std::optional<Code> code_of(const T& value) const {
+    if (decoded_) {
+      for (std::size_t code{0}; code < decoded_->size(); code++) {
+        if ((*decoded_)[code] == value) return static_cast<Code>(code);
+      }
+      return std::nullopt;
+    }
+    auto it = encoding_.find(value);
+    if (it == encoding_.end()) return std::nullopt;
+    return it->second;
+  }
+
+  /**
+   * Get the dictionary we loaded
+   * @return the values indexed by their code, nullptr if not reading
+   */
+  std::shared_ptr<const std::vector<T>> dictionary() const {
+    return decoded_;
+  }
+
+ private:
+  /// the branch holding the distinct values
+  Branch<T> dictionary_;
+  /// the branch holding the codes for each entry
+  Branch<Code> codes_;
+  /// the dictionary loaded from the input file
+  std::shared_ptr<const std::vector<T>> decoded_;
+  /// the codes given to the values we have saved
+  std::unordered_map<T, Code> encoding_;
+};  // Branch<Categorical>
+
+}  // namespace hdtree
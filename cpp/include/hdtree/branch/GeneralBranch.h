@@ -107,6 +107,17 @@ class Branch : public AbstractBranch<DataType> {
     throw HDTreeException(msg.str(), help.str());
   }
 
+  /**
+   * Seeking this dataset involves simply seeking all of the
+   * members of the data type that are loaded.
+   *
+   * @param[in] i_entry entry to move to
+   */
+  void seek(std::size_t i_entry) final override {
+    for (auto& [save, load, m] : members_)
+      if (load) m->seek(i_entry);
+  }
+
   void attach(Reader& f) final override try {
     this->load_type_ = f.type(this->name_);
     for (auto& [save, load, m] : members_)
@@ -53,6 +53,21 @@ class Branch<std::map<KeyType, ValType>>
     }
   }
 
+  /**
+   * Move to the input entry
+   *
+   * The keys and values of the entry start after those of all the
+   * entries before it, so we sum their sizes to find them.
+   *
+   * @param[in] i_entry entry to move to
+   */
+  void seek(std::size_t i_entry) final override {
+    std::size_t i_content = size_.sum_before(i_entry);
+    keys_.seek(i_content);
+    vals_.seek(i_content);
+    size_.seek(i_entry);
+  }
+
   void attach(Reader& f) final override {
     this->load_type_ = f.type(this->name_);
     size_.attach(f);
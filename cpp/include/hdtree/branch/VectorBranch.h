@@ -18,6 +18,16 @@ class Branch<std::vector<ContentType>>
     : public AbstractBranch<std::vector<ContentType>> {
   hdtree_class_version(1);
 
+  /**
+   * Can the content be copied to and from the buffers in bulk?
+   *
+   * std::vector<bool> is not contiguous, so bools are still
+   * copied one at a time.
+   */
+  static constexpr bool is_contiguous_arithmetic =
+      std::is_arithmetic_v<ContentType> and
+      not std::is_same_v<ContentType, bool>;
+
  public:
   /**
    * We create two child data sets, one to hold the successive sizes of the
@@ -45,35 +55,82 @@ class Branch<std::vector<ContentType>>
    * We read the next size and then read that many items from
    * the content data set into the vector handle.
    *
+   * If the content is a contiguous arithmetic type, the items are
+   * copied out of the content's read buffer in bulk.
+   *
    * @param[in] f h5::Reader to load from
    */
   void load() final override {
     size_.load();
     this->handle_->resize(size_.get());
-    for (std::size_t i_vec{0}; i_vec < size_.get(); i_vec++) {
-      data_.load();
-      (*(this->handle_))[i_vec] = data_.get();
+    if constexpr (is_contiguous_arithmetic) {
+      data_.load(this->handle_->data(), this->handle_->size());
+    } else {
+      for (std::size_t i_vec{0}; i_vec < size_.get(); i_vec++) {
+        data_.load();
+        (*(this->handle_))[i_vec] = data_.get();
+      }
     }
   }
 
+  /**
+   * Move to the input entry
+   *
+   * The content of the entry starts after the content of all the
+   * entries before it, so we sum their sizes to find it.
+   *
+   * @param[in] i_entry entry to move to
+   */
+  void seek(std::size_t i_entry) final override {
+    data_.seek(size_.sum_before(i_entry));
+    size_.seek(i_entry);
+  }
+
   /**
    * Save a vector to the output file
    *
    * @note We assume that the saves are done sequentially.
    *
    * We write the size and the content onto the end of their data sets.
+   * Contiguous arithmetic content is copied into the content's write
+   * buffer in bulk.
    *
    * @param[in] f io::Writer to save to
    */
   void save() final override {
     size_.update(this->handle_->size());
     size_.save();
-    for (std::size_t i_vec{0}; i_vec < this->handle_->size(); i_vec++) {
-      data_.update(this->handle_->at(i_vec));
-      data_.save();
+    if constexpr (is_contiguous_arithmetic) {
+      // branches that are only read have nowhere to save their content
+      if (data_.saving()) {
+        data_.save(this->handle_->data(), this->handle_->size());
+      }
+    } else {
+      for (std::size_t i_vec{0}; i_vec < this->handle_->size(); i_vec++) {
+        data_.update(this->handle_->at(i_vec));
+        data_.save();
+      }
     }
   }
 
+  /**
+   * Save the content of n vectors at once
+   *
+   * The sizes and the content are copied into their write buffers in
+   * bulk, skipping the handle entirely.
+   *
+   * @param[in] content pointer to the content of all n vectors serially
+   * @param[in] sizes pointer to the sizes of the n vectors
+   * @param[in] n number of vectors to save
+   */
+  void save(const ContentType* content, const std::size_t* sizes,
+            std::size_t n) {
+    static_assert(is_atomic_v<ContentType>,
+                  "Only vectors of atomic types can be saved in bulk.");
+    size_.save(sizes, n);
+    data_.save(content, std::accumulate(sizes, sizes + n, std::size_t{0}));
+  }
+
   void attach(Writer& f) final override {
     f.structure(this->name_, this->save_type_);
     size_.attach(f);
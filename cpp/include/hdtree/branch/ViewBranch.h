@@ -0,0 +1,109 @@
+#pragma once
+
+#include "hdtree/View.h"
+
+namespace hdtree {
+
+/**
+ * Read-only branch viewing variable-length content in place
+ *
+ * The on-disk layout is the same as Branch<std::vector<T>>, but rather
+ * than copying the content of each entry into a std::vector, we hand out
+ * a View pointing directly into the read buffer of the content.
+ * If the content of an entry spans a refill of the read buffer, we fall
+ * back to copying it into a small scratch buffer that we own.
+ *
+ * @note The view for an entry is only valid until the next load.
+ *
+ * @tparam T arithmetic type of the content
+ */
+template <typename T>
+class Branch<View<T>> : public AbstractBranch<View<T>> {
+  static_assert(std::is_arithmetic_v<T> and not std::is_same_v<T, bool>,
+                "Views are only available for arithmetic types besides bool.");
+
+ public:
+  /**
+   * We create the same two child branches as a vector branch
+   *
+   * @param[in] branch_name full in-file branch_name to set holding this data
+   * @param[in] handle pointer to object already constructed (optional)
+   */
+  explicit Branch(const std::string& branch_name, View<T>* handle = nullptr)
+      : AbstractBranch<View<T>>(branch_name, handle),
+        size_{branch_name + "/" + constants::SIZE_NAME},
+        data_{branch_name + "/data"} {}
+
+  void attach(Reader& f) final override {
+    this->load_type_ = f.type(this->name_);
+    size_.attach(f);
+    data_.attach(f);
+  }
+
+  /**
+   * Load the view of the next entry
+   *
+   * We read the next size and then view that many items
+   * in the read buffer of the content.
+   */
+  void load() final override {
+    size_.load();
+    std::size_t n = size_.get();
+    *(this->handle_) = View<T>(data_.view(n, scratch_), n);
+  }
+
+  /**
+   * Move to the input entry
+   *
+   * @see Branch<std::vector<T>>::seek
+   *
+   * @param[in] i_entry entry to move to
+   */
+  void seek(std::size_t i_entry) final override {
+    data_.seek(size_.sum_before(i_entry));
+    size_.seek(i_entry);
+  }
+
+  /**
+   * Views cannot be written
+   *
+   * @throws HDTreeException always
+   */
+  void attach(Writer&) final override {
+    throw HDTreeException(
+        "HDTreeReadOnly: Branch at " + this->name_ + " is a read-only view.",
+        "Get the branch as a std::vector if you wish to write it out.");
+  }
+
+  /**
+   * Views cannot be handed to other threads
+   *
+   * The view of an entry points into our read buffer which is
+   * refilled as later entries are loaded, so it can't be held
+   * while other entries are loaded.
+   *
+   * @throws HDTreeException always
+   */
+  std::unique_ptr<BaseBranch> sprout() const final override {
+    throw HDTreeException(
+        "HDTreeBadView: Branch at " + this->name_ +
+            " is a view which cannot be held across loads.",
+        "Get the branch as a std::vector if you wish to use it "
+        "while other entries are loaded.");
+  }
+
+  /**
+   * Nothing to save since we are never attached to a writer
+   */
+  void save() final override {}
+
+ private:
+  /// the data set of sizes of the content
+  Branch<std::size_t> size_;
+  /// the data set holding all of the content
+  Branch<T> data_;
+  /// copy of the content of an entry spanning a buffer refill
+  std::vector<T> scratch_;
+};  // Branch<View>
+
+}  // namespace hdtree
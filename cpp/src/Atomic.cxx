@@ -1,11 +1,65 @@
 #include "hdtree/Atomic.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <cstring>
+
 namespace hdtree {
 
 HighFive::EnumType<Bool> create_enum_bool() {
   return {{"TRUE", Bool::TRUE}, {"FALSE", Bool::FALSE}};
 }
 
+void pack_bools(const Bool* bools, std::size_t n, std::uint8_t* bytes) {
+  // Bool has the same size and values as a byte holding 0 or 1
+  const std::uint8_t* in = reinterpret_cast<const std::uint8_t*>(bools);
+  std::size_t i{0};
+#ifdef __SSE2__
+  // sixteen bools at a time: the mask has bit j set if byte j is non-zero
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    int mask = ~_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) & 0xFFFF;
+    bytes[i / 8] = static_cast<std::uint8_t>(mask);
+    bytes[i / 8 + 1] = static_cast<std::uint8_t>(mask >> 8);
+  }
+#endif
+  for (; i + 8 <= n; i += 8) {
+    std::uint8_t byte{0};
+    for (std::size_t j{0}; j < 8; j++) byte |= (in[i + j] != 0) << j;
+    bytes[i / 8] = byte;
+  }
+  if (i < n) {
+    std::uint8_t byte{0};
+    for (std::size_t j{0}; i + j < n; j++) byte |= (in[i + j] != 0) << j;
+    bytes[i / 8] = byte;
+  }
+}
+
+void unpack_bools(const std::uint8_t* bytes, std::size_t n, Bool* bools) {
+  std::uint8_t* out = reinterpret_cast<std::uint8_t*>(bools);
+  std::size_t i{0};
+#ifdef __SSE2__
+  // spread two bytes across sixteen lanes and then select one bit per lane
+  const __m128i bits = _mm_set_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64,
+                                    32, 16, 8, 4, 2, 1);
+  const __m128i one = _mm_set1_epi8(1);
+  for (; i + 16 <= n; i += 16) {
+    std::uint16_t two;
+    std::memcpy(&two, bytes + i / 8, sizeof(two));
+    __m128i v = _mm_cvtsi32_si128(two);
+    v = _mm_unpacklo_epi8(v, v);
+    v = _mm_unpacklo_epi16(v, v);
+    v = _mm_unpacklo_epi32(v, v);
+    v = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(v, bits), bits), one);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), v);
+  }
+#endif
+  for (; i < n; i++) out[i] = (bytes[i / 8] >> (i % 8)) & 1u;
+}
+
 }  // namespace hdtree
 
 template <>
@@ -0,0 +1,228 @@
+#include "hdtree/ChunkAppender.h"
+
+#include <algorithm>
+#include <string>
+
+#include "hdtree/Atomic.h"
+#include "hdtree/Constants.h"
+#include "hdtree/Exception.h"
+
+namespace hdtree {
+
+namespace {
+
+/// number of rows to read through HDF5 at once
+constexpr std::size_t BLOCK_ROWS{1 << 16};
+
+/**
+ * Check if two sets of filters are the same
+ * @param[in] a filters
+ * @param[in] b other filters
+ * @return true if they would produce the same chunks
+ */
+bool same_filters(const ChunkFilters& a, const ChunkFilters& b) {
+  return a.shuffle == b.shuffle and a.deflate_level == b.deflate_level;
+}
+
+}  // namespace
+
+ChunkAppender::ChunkAppender(HighFive::DataSet out, ThreadPool* pool,
+                             std::size_t max_compressing)
+    : out_{std::move(out)},
+      pool_{pool},
+      max_compressing_{std::max<std::size_t>(max_compressing, 1)},
+      type_{out_.getDataType()},
+      elem_size_{type_.getSize()},
+      chunk_rows_{deduce_chunk_rows(out_)},
+      filters_{deduce_chunk_filters(out_)},
+      packed_{out_.hasAttribute(constants::SIZE_NAME)},
+      rows_{out_.getDimensions().at(0)} {
+  direct_ = filters_.has_value() and not type_.isVariableStr();
+  if (packed_ and not direct_) {
+    throw HDTreeException(
+        "HDTreeCopy: Unable to append packed bools with unknown filters.");
+  }
+  if (not direct_) return;
+  std::size_t start = rows_ - rows_ % chunk_rows_;
+  if (packed_) {
+    out_.getAttribute(constants::SIZE_NAME).read(bits_);
+    std::vector<std::uint8_t> bytes(rows_ - start);
+    read_rows(out_, start, bytes.size(), bytes.data());
+    pending_.resize(bits_ - start * 8);
+    unpack_bools(bytes.data(), pending_.size(),
+                 reinterpret_cast<Bool*>(pending_.data()));
+  } else {
+    pending_.resize((rows_ - start) * elem_size_);
+    read_rows(out_, start, rows_ - start, pending_.data());
+  }
+  rows_ = start;
+}
+
+ChunkAppender::~ChunkAppender() {
+  for (auto& chunk : compressing_) chunk.raw.wait();
+}
+
+void ChunkAppender::append(const HighFive::DataSet& in) {
+  std::size_t n = in.getDimensions().at(0);
+  if (packed_) in.getAttribute(constants::SIZE_NAME).read(n);
+  append(in, 0, n);
+}
+
+void ChunkAppender::append(const HighFive::DataSet& in, std::size_t begin,
+                           std::size_t end) {
+  if (end <= begin) return;
+  if (not direct_) {
+    append_through_hdf5(in, begin, end);
+    return;
+  }
+  if (packed_) {
+    std::size_t first_byte = begin / 8;
+    std::size_t n_bits = end - first_byte * 8;
+    std::vector<std::uint8_t> bytes((n_bits + 7) / 8);
+    read_rows(in, first_byte, bytes.size(), bytes.data());
+    std::vector<char> bools(n_bits);
+    unpack_bools(bytes.data(), n_bits, reinterpret_cast<Bool*>(bools.data()));
+    pending_.insert(pending_.end(), bools.begin() + (begin - first_byte * 8),
+                    bools.end());
+    bits_ += end - begin;
+    emit_chunks();
+    return;
+  }
+
+  std::size_t i{begin};
+  auto in_filters = deduce_chunk_filters(in);
+  if (pending_.empty() and in_filters and
+      same_filters(*in_filters, *filters_) and
+      deduce_chunk_rows(in) == chunk_rows_ and i % chunk_rows_ == 0 and
+      in.getDataType() == type_) {
+    for (; i + chunk_rows_ <= end; i += chunk_rows_) copy_chunk(in, i);
+  }
+  while (i < end) {
+    std::size_t m = std::min(BLOCK_ROWS, end - i);
+    std::size_t old = pending_.size();
+    pending_.resize(old + m * elem_size_);
+    read_rows(in, i, m, pending_.data() + old);
+    i += m;
+    emit_chunks();
+  }
+}
+
+void ChunkAppender::finish() {
+  if (not direct_) return;
+  if (not pending_.empty()) {
+    std::size_t n_rows = packed_ ? (pending_.size() + 7) / 8
+                                 : pending_.size() / elem_size_;
+    if (not packed_) pending_.resize(chunk_rows_ * elem_size_, 0);
+    compress(std::move(pending_), n_rows);
+    pending_.clear();
+  }
+  while (not compressing_.empty()) write_next();
+  out_.resize({rows_});
+  if (packed_) out_.getAttribute(constants::SIZE_NAME).write(bits_);
+}
+
+void ChunkAppender::read_rows(const HighFive::DataSet& ds, std::size_t begin,
+                              std::size_t n, void* dest) const {
+  if (n == 0) return;
+  ds.select({begin}, {n}).read(static_cast<char*>(dest), type_);
+}
+
+void ChunkAppender::extend(std::size_t n_rows) {
+  if (out_.getDimensions().at(0) < n_rows) out_.resize({n_rows});
+}
+
+void ChunkAppender::copy_chunk(const HighFive::DataSet& in,
+                               std::size_t i_row) {
+  hsize_t in_offset[1] = {i_row};
+  hsize_t raw_size{0};
+  if (H5Dget_chunk_storage_size(in.getId(), in_offset, &raw_size) < 0 or
+      raw_size == 0) {
+    pending_.resize(chunk_rows_ * elem_size_);
+    read_rows(in, i_row, chunk_rows_, pending_.data());
+    emit_chunks();
+    return;
+  }
+  std::vector<char> raw(raw_size);
+  uint32_t filter_mask{0};
+  if (H5Dread_chunk(in.getId(), H5P_DEFAULT, in_offset, &filter_mask,
+                    raw.data()) < 0) {
+    throw HDTreeException("HDTreeCopy: Unable to read chunk at " +
+                          std::to_string(i_row) + " directly.");
+  }
+  extend(rows_ + chunk_rows_);
+  hsize_t out_offset[1] = {rows_};
+  if (H5Dwrite_chunk(out_.getId(), H5P_DEFAULT, filter_mask, out_offset,
+                     raw.size(), raw.data()) < 0) {
+    throw HDTreeException("HDTreeCopy: Unable to write chunk at " +
+                          std::to_string(rows_) + " directly.");
+  }
+  rows_ += chunk_rows_;
+}
+
+void ChunkAppender::emit_chunks() {
+  std::size_t chunk_size =
+      packed_ ? chunk_rows_ * 8 : chunk_rows_ * elem_size_;
+  std::size_t used{0};
+  while (pending_.size() - used >= chunk_size) {
+    compress(std::vector<char>(pending_.begin() + used,
+                               pending_.begin() + used + chunk_size),
+             chunk_rows_);
+    used += chunk_size;
+  }
+  pending_.erase(pending_.begin(), pending_.begin() + used);
+}
+
+void ChunkAppender::compress(std::vector<char> chunk, std::size_t n_rows) {
+  auto task = [this, chunk = std::move(chunk)]() {
+    if (packed_) {
+      std::vector<std::uint8_t> bytes(chunk_rows_, 0);
+      pack_bools(reinterpret_cast<const Bool*>(chunk.data()), chunk.size(),
+                 bytes.data());
+      return compress_chunk(bytes.data(), bytes.size(), 1, *filters_);
+    }
+    return compress_chunk(chunk.data(), chunk.size(), elem_size_, *filters_);
+  };
+  std::future<std::vector<char>> raw;
+  if (pool_) {
+    raw = pool_->submit(std::move(task));
+  } else {
+    std::promise<std::vector<char>> done;
+    done.set_value(task());
+    raw = done.get_future();
+  }
+  compressing_.push_back({rows_, n_rows, std::move(raw)});
+  rows_ += n_rows;
+  while (compressing_.size() > max_compressing_) write_next();
+}
+
+void ChunkAppender::write_next() {
+  auto next{std::move(compressing_.front())};
+  compressing_.pop_front();
+  std::vector<char> raw = next.raw.get();
+  extend(next.i_row + next.n_rows);
+  hsize_t offset[1] = {next.i_row};
+  if (H5Dwrite_chunk(out_.getId(), H5P_DEFAULT, 0, offset, raw.size(),
+                     raw.data()) < 0) {
+    throw HDTreeException("HDTreeCopy: Unable to write chunk at " +
+                          std::to_string(next.i_row) + " directly.");
+  }
+}
+
+void ChunkAppender::append_through_hdf5(const HighFive::DataSet& in,
+                                        std::size_t begin, std::size_t end) {
+  std::vector<char> block;
+  for (std::size_t i{begin}; i < end; i += BLOCK_ROWS) {
+    std::size_t m = std::min(BLOCK_ROWS, end - i);
+    block.resize(m * elem_size_);
+    read_rows(in, i, m, block.data());
+    extend(rows_ + m);
+    out_.select({rows_}, {m}).write_raw(block.data(), type_);
+    if (type_.isVariableStr()) {
+      auto strings = reinterpret_cast<char**>(block.data());
+      for (std::size_t j{0}; j < m; j++) H5free_memory(strings[j]);
+    }
+    rows_ += m;
+  }
+}
+
+}  // namespace hdtree
@@ -0,0 +1,156 @@
+#include "hdtree/Compression.h"
+
+#include <zlib.h>
+
+#include <cstring>
+
+#include "hdtree/Concurrency.h"
+#include "hdtree/Exception.h"
+
+namespace hdtree {
+
+namespace {
+
+/**
+ * Shuffle the bytes of the elements in the same manner as the HDF5
+ * shuffle filter
+ *
+ * The i'th byte of every element is grouped together so that
+ * similar bytes (e.g. the exponent bytes of floats) are next to
+ * each other, making the compression more effective. Any trailing
+ * bytes that don't make up a whole element are left as is.
+ */
+void shuffle(const char* src, char* dest, std::size_t n_bytes,
+             std::size_t elem_size) {
+  std::size_t n_elems = n_bytes / elem_size;
+  for (std::size_t i_byte{0}; i_byte < elem_size; i_byte++) {
+    char* out = dest + i_byte * n_elems;
+    for (std::size_t i_elem{0}; i_elem < n_elems; i_elem++)
+      out[i_elem] = src[i_elem * elem_size + i_byte];
+  }
+  std::size_t leftover = n_bytes % elem_size;
+  std::memcpy(dest + n_bytes - leftover, src + n_bytes - leftover, leftover);
+}
+
+/**
+ * Undo the byte shuffle for the first n_wanted elements
+ *
+ * @see shuffle for how the bytes were shuffled
+ */
+void unshuffle(const char* src, char* dest, std::size_t n_bytes,
+               std::size_t elem_size, std::size_t n_wanted) {
+  std::size_t n_elems = n_bytes / elem_size;
+  for (std::size_t i_byte{0}; i_byte < elem_size; i_byte++) {
+    const char* in = src + i_byte * n_elems;
+    for (std::size_t i_elem{0}; i_elem < n_wanted; i_elem++)
+      dest[i_elem * elem_size + i_byte] = in[i_elem];
+  }
+}
+
+}  // namespace
+
+std::vector<char> compress_chunk(const void* data, std::size_t n_bytes,
+                                 std::size_t elem_size,
+                                 const ChunkFilters& filters) {
+  const char* src = static_cast<const char*>(data);
+  std::vector<char> shuffled;
+  if (filters.shuffle and elem_size > 1) {
+    shuffled.resize(n_bytes);
+    shuffle(src, shuffled.data(), n_bytes, elem_size);
+    src = shuffled.data();
+  }
+
+  if (filters.deflate_level < 0) {
+    if (src == shuffled.data()) return shuffled;
+    return std::vector<char>(src, src + n_bytes);
+  }
+
+  uLongf compressed_size = compressBound(n_bytes);
+  std::vector<char> compressed(compressed_size);
+  int rc = compress2(reinterpret_cast<Bytef*>(compressed.data()),
+                     &compressed_size, reinterpret_cast<const Bytef*>(src),
+                     n_bytes, filters.deflate_level);
+  if (rc != Z_OK) {
+    throw HDTreeException(
+        "HDTreeCompression: Unable to deflate chunk (zlib error " +
+        std::to_string(rc) + ").");
+  }
+  compressed.resize(compressed_size);
+  return compressed;
+}
+
+std::size_t deduce_chunk_rows(const HighFive::DataSet& ds) {
+  auto lock = hdf5_lock();
+  std::size_t rows{0};
+  hid_t create_props = H5Dget_create_plist(ds.getId());
+  if (H5Pget_layout(create_props) == H5D_CHUNKED) {
+    hsize_t chunk_dims[1];
+    if (H5Pget_chunk(create_props, 1, chunk_dims) == 1) rows = chunk_dims[0];
+  }
+  H5Pclose(create_props);
+  return rows;
+}
+
+std::optional<ChunkFilters> deduce_chunk_filters(const HighFive::DataSet& ds) {
+  if (deduce_chunk_rows(ds) == 0) return std::nullopt;
+  auto lock = hdf5_lock();
+  hid_t create_props = H5Dget_create_plist(ds.getId());
+  ChunkFilters filters;
+  bool known{true};
+  int n_filters = H5Pget_nfilters(create_props);
+  for (int i_filter{0}; i_filter < n_filters; i_filter++) {
+    unsigned int flags, values[8];
+    std::size_t n_values{8};
+    H5Z_filter_t id =
+        H5Pget_filter2(create_props, i_filter, &flags, &n_values, values, 0,
+                       nullptr, nullptr);
+    if (id == H5Z_FILTER_SHUFFLE and i_filter == 0) {
+      filters.shuffle = true;
+    } else if (id == H5Z_FILTER_DEFLATE and i_filter == n_filters - 1) {
+      filters.deflate_level = n_values > 0 ? values[0] : 0;
+    } else {
+      known = false;
+    }
+  }
+  H5Pclose(create_props);
+  if (not known) return std::nullopt;
+  return filters;
+}
+
+void decompress_chunk(const char* raw, std::size_t raw_size,
+                      unsigned int filter_mask, void* dest,
+                      std::size_t n_elems, std::size_t n_wanted,
+                      std::size_t elem_size, const ChunkFilters& filters) {
+  // bit i of the mask is set if the i'th filter in the pipeline was skipped
+  bool shuffled = filters.shuffle and not(filter_mask & 1u);
+  unsigned int deflate_bit = filters.shuffle ? 2u : 1u;
+  bool deflated = filters.deflate_level >= 0 and not(filter_mask & deflate_bit);
+
+  std::size_t n_bytes = n_elems * elem_size;
+  std::vector<char> inflated;
+  const char* src = raw;
+  if (deflated) {
+    inflated.resize(n_bytes);
+    uLongf inflated_size = n_bytes;
+    int rc = uncompress(reinterpret_cast<Bytef*>(inflated.data()),
+                        &inflated_size, reinterpret_cast<const Bytef*>(raw),
+                        raw_size);
+    if (rc != Z_OK or inflated_size != n_bytes) {
+      throw HDTreeException(
+          "HDTreeCompression: Unable to inflate chunk (zlib error " +
+          std::to_string(rc) + ").");
+    }
+    src = inflated.data();
+  } else if (raw_size < n_bytes) {
+    throw HDTreeException(
+        "HDTreeCompression: Chunk read from disk is shorter than expected.");
+  }
+
+  if (shuffled and elem_size > 1) {
+    unshuffle(src, static_cast<char*>(dest), n_bytes, elem_size, n_wanted);
+  } else {
+    std::memcpy(dest, src, n_wanted * elem_size);
+  }
+}
+
+}  // namespace hdtree
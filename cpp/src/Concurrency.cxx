@@ -0,0 +1,55 @@
+#include "hdtree/Concurrency.h"
+
+namespace hdtree {
+
+std::recursive_mutex& hdf5_mutex() {
+  static std::recursive_mutex the_mutex;
+  return the_mutex;
+}
+
+ThreadPool::ThreadPool(std::size_t n_threads, std::size_t max_queued)
+    : max_queued_{max_queued} {
+  workers_.reserve(n_threads);
+  for (std::size_t i{0}; i < n_threads; i++)
+    workers_.emplace_back([this]() { this->work(); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stopping_ = true;
+  }
+  task_ready_.notify_all();
+  for (auto& worker : workers_) worker.join();
+}
+
+void ThreadPool::wait() {
+  std::unique_lock<std::mutex> lock{mutex_};
+  task_done_.wait(lock, [this]() { return tasks_.empty() and active_ == 0; });
+}
+
+void ThreadPool::work() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      task_ready_.wait(lock,
+                       [this]() { return stopping_ or not tasks_.empty(); });
+      // only leave once all of the submitted tasks are done
+      if (tasks_.empty()) return;
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+      ++active_;
+    }
+    task_taken_.notify_one();
+    // exceptions are caught by the packaged_task and put in the future
+    task();
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      --active_;
+    }
+    task_done_.notify_all();
+  }
+}
+
+}  // namespace hdtree
@@ -0,0 +1,468 @@
+#include "hdtree/Merge.h"
+
+#include <algorithm>
+#include <map>
+#include <optional>
+#include <thread>
+
+// using HighFive
+#include <highfive/H5File.hpp>
+
+#include "hdtree/ChunkAppender.h"
+#include "hdtree/Concurrency.h"
+#include "hdtree/Constants.h"
+#include "hdtree/Exception.h"
+#include "hdtree/Version.h"
+
+namespace hdtree {
+
+namespace {
+
+/**
+ * The type and version of a branch (or a member of a branch)
+ */
+struct Node {
+  /// is this a group rather than a data set?
+  bool group;
+  /// the demangled name of the type
+  std::string type;
+  /// the version of the type
+  int version;
+  /// are the two nodes the same?
+  bool operator==(const Node& other) const {
+    return group == other.group and type == other.type and
+           version == other.version;
+  }
+};
+
+/**
+ * Read the type and version of an HDF5 object
+ * @param[in] obj group or data set to describe
+ * @param[in] group true if the object is a group
+ * @return node describing the object, with an empty type if it
+ * doesn't have one
+ */
+template <class Object>
+Node describe(const Object& obj, bool group) {
+  Node node{group, "", 0};
+  if (obj.hasAttribute(constants::TYPE_ATTR_NAME)) {
+    obj.getAttribute(constants::TYPE_ATTR_NAME).read(node.type);
+  }
+  if (obj.hasAttribute(constants::VERS_ATTR_NAME)) {
+    obj.getAttribute(constants::VERS_ATTR_NAME).read(node.version);
+  }
+  return node;
+}
+
+/**
+ * Recursively list the objects inside of a group
+ *
+ * The zone maps and key indices at the top of a tree are not branches,
+ * so they are skipped.
+ *
+ * @param[in] grp group to list
+ * @param[in] path path to the group within the tree, empty for the tree
+ * @param[out] nodes map of paths within the tree to the objects there
+ */
+void walk(const HighFive::Group& grp, const std::string& path,
+          std::map<std::string, Node>& nodes) {
+  for (const auto& name : grp.listObjectNames()) {
+    if (path.empty() and
+        (name == constants::ZONES_NAME or name == constants::INDEX_NAME)) {
+      continue;
+    }
+    std::string full = path.empty() ? name : path + "/" + name;
+    if (grp.getObjectType(name) == HighFive::ObjectType::Group) {
+      auto sub = grp.getGroup(name);
+      nodes[full] = describe(sub, true);
+      walk(sub, full, nodes);
+    } else {
+      nodes[full] = describe(grp.getDataSet(name), false);
+    }
+  }
+}
+
+/**
+ * Read all of the zone maps of a tree
+ * @param[in] tree group of the tree
+ * @return map of branch names to their zones, in the layout of
+ * Writer::saveZones
+ */
+std::map<std::string, std::vector<double>> read_zones(
+    const HighFive::Group& tree) {
+  std::map<std::string, std::vector<double>> zones;
+  if (not tree.exist(constants::ZONES_NAME)) return zones;
+  auto grp = tree.getGroup(constants::ZONES_NAME);
+  std::map<std::string, Node> nodes;
+  walk(grp, constants::ZONES_NAME, nodes);
+  for (const auto& [path, node] : nodes) {
+    if (node.group) continue;
+    auto ds = grp.getDataSet(path.substr(constants::ZONES_NAME.size() + 1));
+    auto dims = ds.getDimensions();
+    std::vector<double> values(dims.at(0) * dims.at(1));
+    if (not values.empty()) {
+      ds.select({0, 0}, dims)
+          .read(values.data(), HighFive::create_datatype<double>());
+    }
+    zones[path.substr(constants::ZONES_NAME.size() + 1)] = std::move(values);
+  }
+  return zones;
+}
+
+/**
+ * An input tree that is being concatenated
+ */
+struct InputTree {
+  /// the file holding the tree
+  HighFive::File file;
+  /// the group of the tree
+  HighFive::Group tree;
+  /// description of the tree for error messages
+  std::string name;
+  /// number of entries in the tree
+  std::size_t size;
+  /// version of the HDTree format
+  int version;
+  /// the branches (and their members) of the tree
+  std::map<std::string, Node> nodes;
+  /// the zone maps of the branches
+  std::map<std::string, std::vector<double>> zones;
+};
+
+/**
+ * Open an input tree and describe its structure
+ * @param[in] file_tree file and tree path of the tree
+ * @return the opened tree
+ */
+InputTree open_tree(const std::pair<std::string, std::string>& file_tree) {
+  try {
+    HighFive::File f(file_tree.first, HighFive::File::ReadOnly);
+    auto tree = f.getGroup(file_tree.second);
+    InputTree in{std::move(f), std::move(tree),
+                 "'" + file_tree.second + "' in '" + file_tree.first + "'",
+                 0, 0, {}, {}};
+    in.tree.getAttribute(constants::SIZE_NAME).read(in.size);
+    in.tree.getAttribute(constants::VERS_ATTR_NAME).read(in.version);
+    walk(in.tree, "", in.nodes);
+    in.zones = read_zones(in.tree);
+    return in;
+  } catch (const HighFive::Exception& e) {
+    throw HDTreeException("Unable to open HDTree '" + file_tree.second +
+                              "' in '" + file_tree.first + "'.",
+                          e.what());
+  }
+}
+
+/**
+ * Check that an input tree has the same structure as the first tree
+ *
+ * @throws HDTreeException if the branches or versions differ
+ *
+ * @param[in] in input tree to check
+ * @param[in] structure branches of the first tree
+ * @param[in] version HDTree version of the first tree
+ */
+void check_structure(const InputTree& in,
+                     const std::map<std::string, Node>& structure,
+                     int version) {
+  if (in.version == version and in.nodes == structure) return;
+  std::string difference = "the HDTree versions differ";
+  for (const auto& [path, node] : structure) {
+    auto it = in.nodes.find(path);
+    if (it == in.nodes.end()) {
+      difference = path + " is missing";
+      break;
+    } else if (not(it->second == node)) {
+      difference = path + " is " + it->second.type + " (version " +
+                   std::to_string(it->second.version) + ") instead of " +
+                   node.type + " (version " + std::to_string(node.version) +
+                   ")";
+      break;
+    }
+  }
+  if (in.nodes.size() > structure.size()) {
+    difference = "it has more branches";
+  }
+  throw HDTreeException(
+      "HDTreeMisType: Unable to concatenate " + in.name + ", " + difference +
+          ".",
+      "All of the trees being concatenated need to have the same branches "
+      "with the same types (and versions of those types).");
+}
+
+/**
+ * Check that a tree being concatenated with others has no categorical
+ * branches
+ *
+ * The codes of a categorical branch index into a dictionary in the
+ * order the values were first seen in that tree, so the codes of
+ * different trees can't be concatenated without remapping them.
+ *
+ * @throws HDTreeException if the tree has a categorical branch
+ *
+ * @param[in] in input tree to check
+ */
+void check_no_categorical(const InputTree& in) {
+  for (const auto& [path, node] : in.nodes) {
+    if (node.type.rfind(constants::CATEGORICAL_TYPE, 0) != 0) continue;
+    throw HDTreeException(
+        "HDTreeMisType: Unable to concatenate " + in.name +
+            " since its branch " + path + " is categorical.",
+        "The codes of categorical branches point into the dictionary of "
+        "their own tree, so they can't be concatenated with the codes of "
+        "other trees. Drop the branch (e.g. with the keep/drop rules of "
+        "`hdtree::Tree::transform`) before concatenating the trees.");
+  }
+}
+
+/**
+ * Append the zone maps of an input tree
+ *
+ * Only the zone maps that every input has are kept.
+ *
+ * @param[in,out] zones concatenated zone maps of the trees before
+ * @param[in] in_zones zone maps of the input tree
+ */
+void append_zones(std::map<std::string, std::vector<double>>& zones,
+                  const std::map<std::string, std::vector<double>>& in_zones) {
+  for (auto it = zones.begin(); it != zones.end();) {
+    auto in_it = in_zones.find(it->first);
+    if (in_it == in_zones.end()) {
+      it = zones.erase(it);
+    } else {
+      it->second.insert(it->second.end(), in_it->second.begin(),
+                        in_it->second.end());
+      ++it;
+    }
+  }
+}
+
+/**
+ * Create the output tree and its attributes
+ * @param[in] out_file file to create the tree in
+ * @param[in] tree_path path to the tree in the file
+ * @param[in] version HDTree version of the inputs
+ * @return the group of the output tree
+ */
+HighFive::Group create_tree(HighFive::File& out_file,
+                            const std::string& tree_path, int version) {
+  HighFive::Group out_tree = out_file.createGroup(tree_path);
+  out_tree.createAttribute(constants::VERS_ATTR_NAME, version);
+  out_tree.createAttribute("__api__", API());
+  out_tree.createAttribute("__api_version__", VERSION());
+  return out_tree;
+}
+
+/**
+ * Write the concatenated zone maps and the size of the output tree
+ * @param[in] out_tree group of the output tree
+ * @param[in] zones concatenated zone maps
+ * @param[in] entries total number of entries
+ */
+void finish_tree(HighFive::Group& out_tree,
+                 const std::map<std::string, std::vector<double>>& zones,
+                 std::size_t entries) {
+  for (const auto& [branch_name, values] : zones) {
+    std::size_t n_zones{values.size() / 3};
+    if (n_zones == 0) continue;
+    auto ds = out_tree.createDataSet(
+        constants::ZONES_NAME + "/" + branch_name,
+        HighFive::DataSpace({n_zones, 3}), HighFive::create_datatype<double>());
+    ds.select({0, 0}, {n_zones, 3})
+        .write_raw(values.data(), HighFive::create_datatype<double>());
+  }
+  out_tree.createAttribute(constants::SIZE_NAME, entries);
+}
+
+/**
+ * Copy the type and version attributes of an object
+ * @param[in] node description of the object
+ * @param[in] obj group or data set to copy them onto
+ */
+template <class Object>
+void copy_attributes(const Node& node, Object&& obj) {
+  if (not node.type.empty()) {
+    obj.createAttribute(constants::TYPE_ATTR_NAME, node.type);
+    obj.createAttribute(constants::VERS_ATTR_NAME, node.version);
+  }
+}
+
+}  // namespace
+
+std::size_t merge(
+    const std::vector<std::pair<std::string, std::string>>& inputs,
+    const std::pair<std::string, std::string>& output,
+    std::size_t n_threads) {
+  if (inputs.empty()) {
+    throw HDTreeException("No trees to merge.",
+                          "Provide at least one input tree.");
+  }
+  if (n_threads == 0) {
+    n_threads = std::max<unsigned int>(std::thread::hardware_concurrency(), 1);
+  }
+  // all of the calls into HDF5 are made on this thread and the
+  // compression tasks never call into HDF5, so we can hold the lock
+  // the whole time
+  auto lock = hdf5_lock();
+  ThreadPool pool(n_threads);
+
+  HighFive::File out_file(output.first,
+                          HighFive::File::Create | HighFive::File::Truncate);
+  std::optional<HighFive::Group> out_tree;
+  std::map<std::string, Node> structure;
+  std::map<std::string, std::vector<double>> zones;
+  std::map<std::string, ChunkAppender> appenders;
+  std::size_t entries{0};
+  int version{0};
+  for (std::size_t i_input{0}; i_input < inputs.size(); i_input++) {
+    InputTree in = open_tree(inputs[i_input]);
+    if (i_input == 0) {
+      if (inputs.size() > 1) check_no_categorical(in);
+      // copy the first tree branch by branch, compressed chunks and all
+      version = in.version;
+      out_tree = create_tree(out_file, output.second, version);
+      for (const auto& obj : in.tree.listObjectNames()) {
+        if (obj == constants::ZONES_NAME or obj == constants::INDEX_NAME) {
+          continue;
+        }
+        if (H5Ocopy(in.tree.getId(), obj.c_str(), out_tree->getId(),
+                    obj.c_str(), H5P_DEFAULT, H5P_DEFAULT) < 0) {
+          throw HDTreeException("HDTreeMerge: Unable to copy branch " + obj +
+                                " from " + in.name + ".");
+        }
+      }
+      structure = std::move(in.nodes);
+      zones = std::move(in.zones);
+      for (const auto& [path, node] : structure) {
+        if (node.group) continue;
+        appenders.emplace(
+            std::piecewise_construct, std::forward_as_tuple(path),
+            std::forward_as_tuple(out_tree->getDataSet(path), &pool,
+                                  2 * n_threads));
+      }
+    } else {
+      check_structure(in, structure, version);
+      for (auto& [path, appender] : appenders) {
+        appender.append(in.tree.getDataSet(path));
+      }
+      append_zones(zones, in.zones);
+    }
+    entries += in.size;
+  }
+
+  for (auto& [_path, appender] : appenders) appender.finish();
+  appenders.clear();
+
+  finish_tree(*out_tree, zones, entries);
+  out_file.flush();
+  return entries;
+}
+
+std::size_t chain(
+    const std::vector<std::pair<std::string, std::string>>& inputs,
+    const std::pair<std::string, std::string>& output) {
+  if (inputs.empty()) {
+    throw HDTreeException("No trees to chain.",
+                          "Provide at least one input tree.");
+  }
+  auto lock = hdf5_lock();
+
+  // find the rows of every data set in every input
+  std::map<std::string, Node> structure;
+  std::map<std::string, std::vector<std::size_t>> rows;
+  std::map<std::string, std::size_t> bits;
+  std::map<std::string, std::vector<double>> zones;
+  std::map<std::string, HighFive::DataType> types;
+  std::size_t entries{0};
+  int version{0};
+  for (std::size_t i_input{0}; i_input < inputs.size(); i_input++) {
+    InputTree in = open_tree(inputs[i_input]);
+    if (i_input == 0) {
+      if (inputs.size() > 1) check_no_categorical(in);
+      version = in.version;
+      structure = in.nodes;
+      zones = in.zones;
+    } else {
+      check_structure(in, structure, version);
+      append_zones(zones, in.zones);
+    }
+    for (const auto& [path, node] : structure) {
+      if (node.group) continue;
+      auto ds = in.tree.getDataSet(path);
+      if (i_input == 0) types.emplace(path, ds.getDataType());
+      rows[path].push_back(ds.getDimensions().at(0));
+      if (ds.hasAttribute(constants::SIZE_NAME)) {
+        // packed bools can only be chained if they fill their last byte
+        if (bits[path] % 8 != 0) {
+          throw HDTreeException(
+              "HDTreeChain: Unable to chain " + in.name + " since the " +
+                  "packed bools of " + path + " before it end partway " +
+                  "through a byte.",
+              "Merge the trees with `hdtree-merge` instead.");
+        }
+        std::size_t n_bits{0};
+        ds.getAttribute(constants::SIZE_NAME).read(n_bits);
+        bits[path] += n_bits;
+      }
+    }
+    entries += in.size;
+  }
+
+  HighFive::File out_file(output.first,
+                          HighFive::File::Create | HighFive::File::Truncate);
+  HighFive::Group out_tree = create_tree(out_file, output.second, version);
+  // parents are listed before their members
+  for (const auto& [path, node] : structure) {
+    if (node.group) {
+      copy_attributes(node, out_tree.createGroup(path));
+      continue;
+    }
+    const auto& in_rows = rows.at(path);
+    hsize_t total{0};
+    for (std::size_t n : in_rows) total += n;
+    hid_t vspace = H5Screate_simple(1, &total, nullptr);
+    hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+    hsize_t offset{0};
+    for (std::size_t i_input{0}; i_input < inputs.size(); i_input++) {
+      hsize_t n = in_rows[i_input];
+      if (n == 0) continue;
+      hid_t src_space = H5Screate_simple(1, &n, nullptr);
+      H5Sselect_hyperslab(vspace, H5S_SELECT_SET, &offset, nullptr, &n,
+                          nullptr);
+      std::string src_path = inputs[i_input].second + "/" + path;
+      herr_t status =
+          H5Pset_virtual(dcpl, vspace, inputs[i_input].first.c_str(),
+                         src_path.c_str(), src_space);
+      H5Sclose(src_space);
+      if (status < 0) {
+        H5Pclose(dcpl);
+        H5Sclose(vspace);
+        throw HDTreeException("HDTreeChain: Unable to map " + path +
+                              " onto '" + inputs[i_input].first + "'.");
+      }
+      offset += n;
+    }
+    H5Sselect_all(vspace);
+    hid_t ds = H5Dcreate2(out_tree.getId(), path.c_str(),
+                          types.at(path).getId(), vspace, H5P_DEFAULT, dcpl,
+                          H5P_DEFAULT);
+    H5Pclose(dcpl);
+    H5Sclose(vspace);
+    if (ds < 0) {
+      throw HDTreeException("HDTreeChain: Unable to create virtual data set " +
+                            path + ".");
+    }
+    H5Dclose(ds);
+    auto out_ds = out_tree.getDataSet(path);
+    copy_attributes(structure.at(path), out_ds);
+    if (bits.count(path)) {
+      out_ds.createAttribute(constants::SIZE_NAME, bits.at(path));
+    }
+  }
+
+  finish_tree(out_tree, zones, entries);
+  out_file.flush();
+  return entries;
+}
+
+}  // namespace hdtree
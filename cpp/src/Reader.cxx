@@ -1,45 +1,148 @@
 #include "hdtree/Reader.h"
 
-#include "hdtree/Branch.h"
+#include <algorithm>
+#include <optional>
+
+#include "hdtree/ChunkAppender.h"
 #include "hdtree/Constants.h"
 
 namespace hdtree {
 
+namespace {
+
+/**
+ * Count the values stored in a branch that is not indexed by entry
+ *
+ * @param[in] tree group of the tree holding the branch
+ * @param[in] path path to the branch within the tree
+ * @return number of values (rather than bytes if the bools are packed)
+ */
+std::size_t count_values(const HighFive::Group& tree,
+                         const std::string& path) {
+  if (tree.getObjectType(path) == HighFive::ObjectType::Group) {
+    // flat strings
+    return count_values(tree, path + "/" + constants::SIZE_NAME);
+  }
+  auto ds = tree.getDataSet(path);
+  std::size_t n{ds.getDimensions().at(0)};
+  if (ds.hasAttribute(constants::SIZE_NAME)) {
+    ds.getAttribute(constants::SIZE_NAME).read(n);
+  }
+  return n;
+}
+
+}  // namespace
+
 Reader::Reader(const std::pair<std::string, std::string>& file_tree_path,
                bool inplace)
+    : Reader(file_tree_path, inplace, hdf5_lock()) {}
+
+Reader::Reader(const std::pair<std::string, std::string>& file_tree_path,
+               bool inplace, std::unique_lock<std::recursive_mutex>)
     : file_{file_tree_path.first,
             inplace ? HighFive::File::ReadWrite : HighFive::File::ReadOnly},
-      tree_{file_.getGroup(file_tree_path.second)} {
+      tree_{file_.getGroup(file_tree_path.second)},
+      tree_path_{file_tree_path.second} {
   HighFive::Attribute size_attr = tree_.getAttribute(constants::SIZE_NAME);
   size_attr.read(entries_);
 }
 
-std::string Reader::name() const { return file_.getName(); }
+std::string Reader::name() const {
+  auto lock = hdf5_lock();
+  return file_.getName();
+}
 
 std::vector<std::string> Reader::list(const std::string& group_path) const {
+  auto lock = hdf5_lock();
   // just return empty list of group does not exist
   if (not tree_.exist(group_path)) return {};
   return tree_.getGroup(group_path).listObjectNames();
 }
 
 HighFive::DataSet Reader::getDataSet(const std::string& branch_name) const {
+  auto lock = hdf5_lock();
   return tree_.getDataSet(branch_name);
 }
 
+std::vector<double> Reader::loadZones(const std::string& branch_name) const {
+  auto lock = hdf5_lock();
+  auto path = constants::ZONES_NAME + "/" + branch_name;
+  if (not tree_.exist(path)) return {};
+  auto ds = tree_.getDataSet(path);
+  auto dims = ds.getDimensions();
+  if (dims.size() != 2 or dims.at(1) != 3) {
+    throw HDTreeException("HDTreeBadZones: Zone map of branch " + branch_name +
+                          " is not an N x 3 data set.");
+  }
+  std::vector<double> zones(dims.at(0) * 3);
+  if (not zones.empty()) {
+    ds.select({0, 0}, dims)
+        .read(zones.data(), HighFive::create_datatype<double>());
+  }
+  return zones;
+}
+
+std::size_t Reader::getReadBufferRows(const HighFive::DataSet& ds) const {
+  auto lock = hdf5_lock();
+  std::size_t elem_size = std::max<std::size_t>(ds.getDataType().getSize(), 1);
+  std::size_t rows_per_chunk = std::max<std::size_t>(deduce_chunk_rows(ds), 1);
+  std::size_t chunks_per_buffer = std::max<std::size_t>(
+      read_buffer_size_ / (rows_per_chunk * elem_size), 1);
+  return chunks_per_buffer * rows_per_chunk;
+}
+
+void Reader::setPrefetch(bool prefetch) {
+  if (prefetch and not prefetcher_) {
+    prefetcher_ = std::make_shared<ThreadPool>(1);
+  } else if (not prefetch) {
+    prefetcher_.reset();
+  }
+}
+
+void Reader::setDecompressionThreads(std::size_t n_threads) {
+  if (n_threads > 0) {
+    decompressor_ = std::make_shared<ThreadPool>(n_threads);
+  } else {
+    decompressor_.reset();
+  }
+}
+
 HighFive::DataType Reader::getDataSetType(const std::string& dataset) const {
+  auto lock = hdf5_lock();
   return getDataSet(dataset).getDataType();
 }
 
 HighFive::ObjectType Reader::getH5ObjectType(const std::string& path) const {
+  auto lock = hdf5_lock();
   return tree_.getObjectType(path);
 }
 
 std::vector<std::pair<std::string, std::string>> Reader::availableObjects() {
-  // TODO recursively list branches in tree
-  return {};
+  auto lock = hdf5_lock();
+  std::vector<std::pair<std::string, std::string>> branches;
+  std::vector<std::string> todo;
+  for (const auto& name : tree_.listObjectNames()) {
+    if (name != constants::ZONES_NAME and name != constants::INDEX_NAME) {
+      todo.push_back(name);
+    }
+  }
+  while (not todo.empty()) {
+    std::string name = todo.back();
+    todo.pop_back();
+    if (getH5ObjectType(name) == HighFive::ObjectType::Group and
+        not tree_.getGroup(name).hasAttribute(constants::TYPE_ATTR_NAME)) {
+      for (const auto& sub : list(name)) todo.push_back(name + "/" + sub);
+    } else {
+      branches.emplace_back(name, this->type(name).first);
+    }
+  }
+  std::sort(branches.begin(), branches.end());
+  return branches;
 }
 
-std::pair<std::string, int> Reader::type(const std::string& branch_name) {
+std::pair<std::string, int> Reader::type(
+    const std::string& branch_name) const {
+  auto lock = hdf5_lock();
   HighFive::Attribute type_attr =
       getH5ObjectType(branch_name) == HighFive::ObjectType::Dataset
           ? tree_.getDataSet(branch_name)
@@ -59,142 +162,112 @@ std::pair<std::string, int> Reader::type(const std::string& branch_name) {
   return std::make_pair(type, vers);
 }
 
-void Reader::mirror(const std::string& branch_name, Writer& output) {
-  // only mirror structure of groups
-  if (getH5ObjectType(branch_name) != HighFive::ObjectType::Group) return;
-  // copy over type attributes creating the group in the output file
-  output.structure(branch_name, this->type(branch_name));
-  // recurse into subobjects
-  for (auto& subgrp : this->list(branch_name))
-    mirror(branch_name + "/" + subgrp, output);
-}
-
-void Reader::copy(unsigned int long i_entry, const std::string& branch_name,
-                  Writer& output) {
-  if (mirror_objects_.find(branch_name) == mirror_objects_.end()) {
-    /**
-     * this is where recursing into the subgroups of full_name occurs
-     * if this mirror object hasn't been created yet
-     *
-     * If a mirror object is being created that means the event object
-     * satisfies the following:
-     * 1. The event object exists in the input file
-     * 2. The event object should be written to the output file
-     * 3. The event object HAS NOT been accessed during the processing
-     *    of this input file yet
-     *
-     * This means we should copy over the structure of this event object
-     * from the input file into the output file.
-     */
-    mirror(branch_name, output);
-    mirror_objects_.emplace(std::make_pair(
-        branch_name,
-        std::make_unique<MirrorObject>(branch_name, *this, output)));
+void Reader::copy(const std::string& branch_name,
+                  const std::vector<EntryRange>& entries, Writer& output,
+                  bool link) {
+  auto lock = hdf5_lock();
+  copyObject(branch_name, entries, output, link);
+  if (entries.size() == 1 and entries.front().begin == 0 and
+      entries.front().end == entries_) {
+    output.saveZones(branch_name, loadZones(branch_name));
   }
-  // do the copying
-  mirror_objects_[branch_name]->copy(i_entry, 1);
 }
 
-Reader::MirrorObject::MirrorObject(const std::string& branch_name,
-                                   Reader& reader, Writer& writer) {
-  if (reader.getH5ObjectType(branch_name) == HighFive::ObjectType::Dataset) {
-    // simple atomic event object
-    //  unfortunately, I can't think of a better solution than manually
-    //  copying the code for all of the types
-    HighFive::DataType type = reader.getDataSetType(branch_name);
-    if (type == HighFive::create_datatype<int>()) {
-      data_ = std::make_unique<Branch<int>>(branch_name);
-    } else if (type == HighFive::create_datatype<long int>()) {
-      data_ = std::make_unique<Branch<long int>>(branch_name);
-    } else if (type == HighFive::create_datatype<long long int>()) {
-      data_ = std::make_unique<Branch<long long int>>(branch_name);
-    } else if (type == HighFive::create_datatype<unsigned int>()) {
-      data_ = std::make_unique<Branch<unsigned int>>(branch_name);
-    } else if (type == HighFive::create_datatype<unsigned long int>()) {
-      data_ = std::make_unique<Branch<unsigned long int>>(branch_name);
-    } else if (type == HighFive::create_datatype<unsigned long long int>()) {
-      data_ = std::make_unique<Branch<unsigned long long int>>(branch_name);
-    } else if (type == HighFive::create_datatype<float>()) {
-      data_ = std::make_unique<Branch<float>>(branch_name);
-    } else if (type == HighFive::create_datatype<double>()) {
-      data_ = std::make_unique<Branch<double>>(branch_name);
-    } else if (type == HighFive::create_datatype<std::string>()) {
-      data_ = std::make_unique<Branch<std::string>>(branch_name);
-    } else if (type == HighFive::create_datatype<hdtree::Bool>()) {
-      data_ = std::make_unique<Branch<bool>>(branch_name);
-    } else {
-      throw HDTreeException(
-          "HDTreeUnknownDS: Unable to deduce C++ type "
-          "from H5 type during a copy",
-          "This is a very deep exception and can come from many "
-          "different places, but most commonly this comes from "
-          "writing a custom HDF5 Data Type into a file. Since "
-          "HDTree does not know how to load these custom data "
-          "type descriptions, it is unable to load this type of "
-          "data in a branch for copying.");
+void Reader::copyObject(const std::string& path,
+                        const std::vector<EntryRange>& rows, Writer& output,
+                        bool link) {
+  if (getH5ObjectType(path) == HighFive::ObjectType::Dataset) {
+    auto in = tree_.getDataSet(path);
+    // packed bools count their bools rather than their bytes
+    bool packed = in.hasAttribute(constants::SIZE_NAME);
+    link = link and rows.size() == 1 and not rows.front().empty() and
+           (not packed or rows.front().begin % 8 == 0);
+    std::optional<HighFive::DataSet> linked;
+    if (link) {
+      const auto& r = rows.front();
+      std::size_t begin = packed ? r.begin / 8 : r.begin;
+      std::size_t n = packed ? (r.end + 7) / 8 - begin : r.size();
+      linked = output.createVirtualDataSet(path, in.getDataType(), n,
+                                           {name(), tree_path_ + "/" + path},
+                                           begin);
     }
-    data_->attach(reader);
-    data_->attach(writer);
-  } else {
-    // event object is a H5 group meaning it is more complicated
-    // than a simple atomic type
-    auto subobjs = reader.list(branch_name);
-    for (auto& subobj : subobjs) {
-      std::string sub_path{branch_name + "/" + subobj};
-      if (subobj == constants::SIZE_NAME) {
-        size_member_ = std::make_unique<Branch<std::size_t>>(sub_path);
-        size_member_->attach(reader);
-        size_member_->attach(writer);
+    auto out = linked ? *linked : output.createDataSet(path, in.getDataType());
+    for (const auto& attr : {constants::TYPE_ATTR_NAME,
+                             constants::VERS_ATTR_NAME}) {
+      if (not in.hasAttribute(attr)) continue;
+      if (attr == constants::TYPE_ATTR_NAME) {
+        std::string type;
+        in.getAttribute(attr).read(type);
+        out.createAttribute(attr, type);
       } else {
-        obj_members_.emplace_back(
-            std::make_unique<MirrorObject>(sub_path, reader, writer));
+        int vers{0};
+        in.getAttribute(attr).read(vers);
+        out.createAttribute(attr, vers);
       }
     }
-  }
-}
-
-void Reader::MirrorObject::copy(unsigned long int i_entry,
-                                unsigned long int n) {
-  unsigned long int num_to_advance{
-      i_entry <= last_entry_ ? 0 : i_entry - last_entry_ - 1},
-      num_to_save{n};
-  last_entry_ = i_entry;
-
-  // if we have a data member, the data member is the only part of this
-  // mirror object
-  if (data_) {
-    // load until one before desired entry
-    for (std::size_t i{0}; i < num_to_advance; i++) data_->load();
-    // load and save desired entries
-    for (std::size_t i{0}; i < num_to_save; i++) {
-      data_->load();
-      data_->save();
+    if (packed) {
+      out.createAttribute(constants::SIZE_NAME,
+                          linked ? rows.front().size() : std::size_t{0});
     }
+    if (linked) return;
+    auto compressor = output.getCompressor();
+    ChunkAppender appender(out, compressor.get(), 8);
+    for (const auto& r : rows) appender.append(in, r.begin, r.end);
+    appender.finish();
     return;
   }
 
-  /// if there is a member determining the size of each entry,
-  /// we need to follow its lead
-  if (size_member_) {
-    unsigned long int new_num_to_advance{0};
-    for (std::size_t i{0}; i < num_to_advance; i++) {
-      size_member_->load();
-      new_num_to_advance +=
-          dynamic_cast<Branch<std::size_t>&>(*size_member_).get();
+  // copy over type attributes creating the group in the output file
+  bool categorical{false};
+  if (tree_.getGroup(path).hasAttribute(constants::TYPE_ATTR_NAME)) {
+    auto type = this->type(path);
+    categorical = (type.first.rfind(constants::CATEGORICAL_TYPE, 0) == 0);
+    output.structure(path, type);
+  }
+  auto members = this->list(path);
+  std::vector<EntryRange> member_rows{rows};
+  if (std::find(members.begin(), members.end(), constants::SIZE_NAME) !=
+      members.end()) {
+    // the members hold the content of the entries, so we
+    // sum the sizes up to each end of the rows being copied
+    auto sizes = tree_.getDataSet(path + "/" + constants::SIZE_NAME);
+    std::vector<std::size_t> block;
+    std::size_t i_row{0}, offset{0};
+    auto offset_at = [&](std::size_t row) {
+      while (i_row < row) {
+        std::size_t n = std::min<std::size_t>(row - i_row, 1 << 16);
+        block.resize(n);
+        sizes.select({i_row}, {n})
+            .read(block.data(), HighFive::create_datatype<std::size_t>());
+        for (std::size_t size : block) offset += size;
+        i_row += n;
+      }
+      return offset;
+    };
+    member_rows.clear();
+    for (const auto& r : rows) {
+      EntryRange content{offset_at(r.begin), 0};
+      content.end = offset_at(r.end);
+      if (content.empty()) continue;
+      if (not member_rows.empty() and member_rows.back().end == content.begin) {
+        member_rows.back().end = content.end;
+      } else {
+        member_rows.push_back(content);
+      }
     }
-    unsigned long int new_num_to_save = 0;
-    for (std::size_t i{0}; i < num_to_save; i++) {
-      size_member_->load();
-      new_num_to_save +=
-          dynamic_cast<Branch<std::size_t>&>(*size_member_).get();
-      size_member_->save();
+  }
+  for (const auto& member : members) {
+    if (categorical and member == constants::DICTIONARY_NAME) {
+      // the dictionary is shared by all of the entries
+      std::string dict_path{path + "/" + member};
+      copyObject(dict_path, {EntryRange{0, count_values(tree_, dict_path)}},
+                 output, link);
+      continue;
     }
-
-    num_to_advance = new_num_to_advance;
-    num_to_save = new_num_to_save;
+    copyObject(path + "/" + member,
+               member == constants::SIZE_NAME ? rows : member_rows, output,
+               link);
   }
-
-  for (auto& obj : obj_members_) obj->copy(num_to_advance, num_to_save);
 }
 
 }  // namespace hdtree
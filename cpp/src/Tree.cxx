@@ -1,11 +1,36 @@
 #include "hdtree/Tree.h"
 
+#include <fnmatch.h>
+
 namespace hdtree {
 
 Tree Tree::load(const std::string& file_path, const std::string& tree_path) {
   return Tree({file_path, tree_path}, {"", ""});
 }
 
+Tree Tree::load(const std::string& file_path, const std::string& tree_path,
+                const EntryRange& range) {
+  Tree t({file_path, tree_path}, {"", ""});
+  if (range.end > t.range_.end or range.begin > range.end) {
+    throw HDTreeException(
+        "Entry range [" + std::to_string(range.begin) + ", " +
+            std::to_string(range.end) + ") is not within the tree '" +
+            tree_path + "' in '" + file_path + "'.",
+        "This tree only has " + std::to_string(t.range_.end) + " entries.");
+  }
+  t.range_ = range;
+  t.i_entry_ = range.begin;
+  return t;
+}
+
+Tree Tree::load(const std::string& file_path, const std::string& tree_path,
+                std::size_t i_shard, std::size_t n_shards) {
+  Tree t({file_path, tree_path}, {"", ""});
+  t.range_ = t.range_.shard(i_shard, n_shards);
+  t.i_entry_ = t.range_.begin;
+  return t;
+}
+
 Tree Tree::save(const std::string& file_path, const std::string& tree_path) {
   return Tree({"", ""}, {file_path, tree_path});
 }
@@ -24,7 +49,272 @@ Tree Tree::transform(const std::pair<std::string, std::string>& src,
   return Tree(src, dest);
 }
 
+Tree Tree::transform(const std::pair<std::string, std::string>& src,
+                     const std::pair<std::string, std::string>& dest,
+                     const std::vector<std::string>& rules) {
+  Tree t = transform(src, dest);
+  for (const auto& rule : rules) {
+    auto space = rule.find(' ');
+    std::string action = rule.substr(0, space);
+    if (space == std::string::npos or (action != "keep" and action != "drop")) {
+      throw HDTreeException(
+          "Unable to parse the keep/drop rule '" + rule + "'.",
+          "Rules are either 'keep <glob>' or 'drop <glob>'.");
+    }
+    t.rules_.emplace_back(rule.substr(space + 1), action == "keep");
+  }
+  return t;
+}
+
+void Tree::set_read_buffer_size(std::size_t bytes) {
+  if (not reader_) {
+    throw HDTreeException(
+        "Attempting to configure read buffers without reading.",
+        "Only trees that are loading data from an input file have "
+        "read buffers to configure.");
+  }
+  reader_->setReadBufferSize(bytes);
+}
+
+void Tree::set_prefetch(bool prefetch) {
+  if (not reader_) {
+    throw HDTreeException(
+        "Attempting to configure prefetching without reading.",
+        "Only trees that are loading data from an input file have "
+        "read buffers to prefetch.");
+  }
+  reader_->setPrefetch(prefetch);
+}
+
+void Tree::set_decompression_threads(std::size_t n_threads) {
+  if (not reader_) {
+    throw HDTreeException(
+        "Attempting to configure decompression without reading.",
+        "Only trees that are loading data from an input file have "
+        "chunks to decompress.");
+  }
+  reader_->setDecompressionThreads(n_threads);
+}
+
+void Tree::set_write_behind(bool write_behind, std::size_t max_queued) {
+  if (not writer_) {
+    throw HDTreeException(
+        "Attempting to configure writing behind without writing.",
+        "Only trees that are saving data to an output file have "
+        "write buffers to flush in the background.");
+  }
+  writer_->setWriteBehind(write_behind, max_queued);
+}
+
+void Tree::set_compression_threads(std::size_t n_threads) {
+  if (not writer_) {
+    throw HDTreeException(
+        "Attempting to configure compression without writing.",
+        "Only trees that are saving data to an output file have "
+        "chunks to compress.");
+  }
+  writer_->setCompressionThreads(n_threads);
+}
+
+void Tree::set_pack_bools(bool pack) {
+  if (not writer_) {
+    throw HDTreeException(
+        "Attempting to configure bool packing without writing.",
+        "Only trees that are saving data to an output file "
+        "create new bool branches.");
+  }
+  writer_->setPackBools(pack);
+}
+
+void Tree::set_flat_strings(bool flat) {
+  if (not writer_) {
+    throw HDTreeException(
+        "Attempting to configure flat strings without writing.",
+        "Only trees that are saving data to an output file "
+        "create new string branches.");
+  }
+  writer_->setFlatStrings(flat);
+}
+
+void Tree::set_zone_maps(bool zone_maps) {
+  if (not writer_) {
+    throw HDTreeException(
+        "Attempting to configure zone maps without writing.",
+        "Only trees that are saving data to an output file "
+        "record zone maps.");
+  }
+  writer_->setZoneMaps(zone_maps);
+}
+
+void Tree::set_link_untouched(bool link) {
+  if (not reader_ or not writer_ or inplace_) {
+    throw HDTreeException(
+        "Attempting to link untouched branches without transforming.",
+        "Only trees that are transforming an input tree into a new "
+        "output file (`hdtree::Tree::transform`) have untouched branches.");
+  }
+  if (rules_.empty()) {
+    throw HDTreeException(
+        "Attempting to link untouched branches without keep/drop rules.",
+        "Only the branches kept by the keep/drop rules of a transform are "
+        "passed through, so give the rules when making the tree.");
+  }
+  link_untouched_ = link;
+}
+
+std::vector<EntryRange> Tree::select(const std::string& branch_name,
+                                     const Interval& cut) const {
+  if (not reader_) {
+    throw HDTreeException(
+        "Attempting to select entries without reading.",
+        "Entries are selected with the zone maps in an input file, make "
+        "sure you've loaded a tree if you wish to select entries.");
+  }
+  ZoneMap zones(reader_->loadZones(branch_name));
+  if (zones.empty()) return {range_};
+  return zones.select(cut, range_);
+}
+
+std::vector<EntryRange> Tree::select(
+    const std::vector<std::pair<std::string, Interval>>& cuts) const {
+  std::vector<EntryRange> selected{range_};
+  for (const auto& [branch_name, cut] : cuts) {
+    selected = intersect(selected, select(branch_name, cut));
+  }
+  return selected;
+}
+
+void Tree::build_index(const std::vector<std::string>& key_names) {
+  if (not inplace_) {
+    throw HDTreeException(
+        "Attempting to build an index without updating a tree in place.",
+        "The index is saved into the same file as the tree, so it can "
+        "only be built on trees opened with `hdtree::Tree::inplace`.");
+  }
+  if (key_names.empty()) {
+    throw HDTreeException("Attempting to build an index without any keys.",
+                          "Provide the names of the key branches.");
+  }
+  std::size_t n_entries{reader_->entries()};
+  EntryRange all{0, n_entries};
+  std::vector<std::vector<std::int64_t>> keys;
+  for (const auto& name : key_names) {
+    bool integer{false}, large_unsigned{false};
+    {
+      // the type needs to be released while holding the lock
+      auto lock = hdf5_lock();
+      if (reader_->getH5ObjectType(name) == HighFive::ObjectType::Dataset) {
+        auto type = reader_->getDataSetType(name);
+        integer = (type.getClass() == HighFive::DataTypeClass::Integer);
+        large_unsigned = (H5Tget_sign(type.getId()) == H5T_SGN_NONE and
+                          type.getSize() >= sizeof(std::int64_t));
+      }
+    }
+    if (not integer) {
+      throw HDTreeException(
+          "Key branch '" + name + "' is not an atomic integer branch.",
+          "Only atomic integer branches can be used as keys.");
+    }
+    if (not large_unsigned) {
+      keys.push_back(Column<std::int64_t>(*reader_, name, all).read());
+      continue;
+    }
+    // HDF5 would clamp values beyond the index into its range,
+    // so we read them as they are and check them ourselves
+    auto values = Column<std::uint64_t>(*reader_, name, all).read();
+    auto& key = keys.emplace_back(values.size());
+    for (std::size_t i{0}; i < values.size(); i++) {
+      if (values[i] > std::numeric_limits<std::int64_t>::max()) {
+        throw HDTreeException(
+            "Key branch '" + name + "' holds the value " +
+                std::to_string(values[i]) + " at entry " + std::to_string(i) +
+                " which is too large for the index.",
+            "The index holds the keys as 64-bit signed integers.");
+      }
+      key[i] = static_cast<std::int64_t>(values[i]);
+    }
+  }
+
+  std::vector<std::size_t> order(n_entries);
+  std::iota(order.begin(), order.end(), std::size_t{0});
+  std::stable_sort(order.begin(), order.end(),
+                   [&keys](std::size_t a, std::size_t b) {
+                     for (const auto& key : keys) {
+                       if (key[a] != key[b]) return key[a] < key[b];
+                     }
+                     return false;
+                   });
+
+  std::size_t n_columns{keys.size() + 1};
+  std::vector<std::int64_t> rows(n_entries * n_columns);
+  for (std::size_t i{0}; i < n_entries; i++) {
+    for (std::size_t j{0}; j < keys.size(); j++) {
+      rows[i * n_columns + j] = keys[j][order[i]];
+    }
+    rows[i * n_columns + keys.size()] = static_cast<std::int64_t>(order[i]);
+  }
+  auto name = KeyIndex::name(key_names);
+  indices_.erase(name);
+  writer_->saveIndex(name, rows, n_columns);
+}
+
+std::vector<std::size_t> Tree::find(const std::vector<std::string>& key_names,
+                                    const std::vector<std::int64_t>& key) {
+  if (not reader_) {
+    throw HDTreeException(
+        "Attempting to find entries without reading.",
+        "Entries are found with an index in an input file, make sure "
+        "you've loaded a tree if you wish to find entries.");
+  }
+  if (key.size() != key_names.size()) {
+    throw HDTreeException(
+        "Looking up a key with " + std::to_string(key.size()) +
+            " values in an index of " + std::to_string(key_names.size()) +
+            " keys.",
+        "Provide one value for each key branch.");
+  }
+  auto name = KeyIndex::name(key_names);
+  auto it = indices_.find(name);
+  if (it == indices_.end()) {
+    it = indices_
+             .emplace(name, std::make_unique<KeyIndex>(*reader_, key_names,
+                                                       reader_->entries()))
+             .first;
+  }
+  return it->second->find(key);
+}
+
 void Tree::save() {
+  if (not rules_.empty() and i_entry_ == 0) {
+    throw HDTreeException(
+        "Attempting to save an entry before loading one while copying "
+        "untouched branches.",
+        "The untouched branches are copied from the entries that were "
+        "loaded and saved, so each saved entry needs to be loaded first.");
+  }
+  save_loaded(i_entry_ - 1);
+}
+
+void Tree::save_loaded(std::size_t i_entry) {
+  if (not rules_.empty()) {
+    if (saved_.empty() or saved_.back().end < i_entry) {
+      saved_.push_back({i_entry, i_entry + 1});
+    } else if (saved_.back().end == i_entry) {
+      saved_.back().end++;
+    } else {
+      throw HDTreeException(
+          "Attempting to save entry " + std::to_string(i_entry) +
+              " more than once while copying untouched branches.",
+          "Each loaded entry can only be saved once when the untouched "
+          "branches are being copied.");
+    }
+  }
+  if (not filled_.empty()) {
+    throw HDTreeException(
+        "Attempting to save an entry while columns are being filled.",
+        "Call `tree.save(n)` after filling the columns of n entries "
+        "before saving entries one at a time.");
+  }
   for (auto& [_name, br] : branches_) {
     br->save();
     br->clear();
@@ -32,17 +322,194 @@ void Tree::save() {
   if (writer_) writer_->increment();
 }
 
+void Tree::save(std::size_t n) {
+  if (not writer_) {
+    throw HDTreeException(
+        "Attempting to save filled columns without writing.",
+        "Only trees that are saving data to an output file "
+        "have columns to fill.");
+  }
+  if (not rules_.empty()) {
+    throw HDTreeException(
+        "Attempting to save filled columns while copying untouched branches.",
+        "The untouched branches are copied from the entries that were "
+        "loaded and saved one at a time.");
+  }
+  for (const auto& [name, _br] : branches_) {
+    auto it = filled_.find(name);
+    std::size_t n_filled = it == filled_.end() ? 0 : it->second;
+    if (n_filled != n) {
+      throw HDTreeException(
+          "Branch named '" + name + "' was filled with " +
+              std::to_string(n_filled) + " entries but " + std::to_string(n) +
+              " entries are being saved.",
+          "Every branch needs to be filled with the same number of entries "
+          "by `tree.fill_column` before they are saved.");
+    }
+  }
+  filled_.clear();
+  writer_->increment(n);
+}
+
 void Tree::load() {
-  for (auto& [_name, br] : branches_) br->load();
+  if (not batches_.empty()) {
+    throw HDTreeException(
+        "Attempting to load an entry with branches loaded in batches.",
+        "Branches retrieved with `tree.get_batch` are only loaded by "
+        "`tree.for_each_batch`, retrieve them with `tree.get` to load "
+        "them entry by entry.");
+  }
+  for (auto* br : inputs_) br->load();
+  i_entry_++;
+}
+
+void Tree::seek(std::size_t entry) {
+  if (not reader_) {
+    throw HDTreeException(
+        "Attempting to seek without reading.",
+        "Only trees that are loading data from an input file have "
+        "entries to move to.");
+  }
+  if (writer_) {
+    throw HDTreeException(
+        "Attempting to seek while writing.",
+        "Entries are saved in the order they are visited, so seeking is "
+        "only allowed for trees that are only reading (`hdtree::Tree::load`).");
+  }
+  if (entry > *entries_) {
+    throw HDTreeException(
+        "Attempting to seek to entry " + std::to_string(entry) +
+            " past the end of the tree.",
+        "This tree only has " + std::to_string(*entries_) + " entries.");
+  }
+  for (auto* br : inputs_) br->seek(entry);
+  for (auto& [_name, batch] : batches_) batch->seek(entry);
+  i_entry_ = entry;
+}
+
+void Tree::load(std::size_t entry) {
+  seek(entry);
+  load();
+}
+
+void Tree::close() {
+  if (closed_) return;
+  closed_ = true;
+  indices_.clear();
+  batches_.clear();
+  inputs_.clear();
+  branches_.clear();
+  // the background writes need the lock to finish
+  if (writer_) writer_->flush();
+  if (reader_ and writer_ and not rules_.empty()) {
+    copy_untouched(written_);
+  }
+  auto lock = hdf5_lock();
+  reader_.reset();
+  writer_.reset();
+}
+
+Tree::~Tree() {
+  try {
+    close();
+  } catch (...) {
+    // nowhere to report errors, those that want them call close
+  }
+  auto lock = hdf5_lock();
+  reader_.reset();
+  writer_.reset();
+}
+
+Tree& Tree::operator=(Tree&& other) {
+  if (this == &other) return *this;
+  // the members can't simply be moved in order since our branches
+  // need to finish writing before our writer is flushed and closed
+  try {
+    close();
+  } catch (...) {
+    // same as when destructing
+  }
+  {
+    auto lock = hdf5_lock();
+    reader_.reset();
+    writer_.reset();
+  }
+  entries_ = std::move(other.entries_);
+  reader_ = std::move(other.reader_);
+  writer_ = std::move(other.writer_);
+  branches_ = std::move(other.branches_);
+  inputs_ = std::move(other.inputs_);
+  filled_ = std::move(other.filled_);
+  batches_ = std::move(other.batches_);
+  indices_ = std::move(other.indices_);
+  inplace_ = other.inplace_;
+  range_ = other.range_;
+  i_entry_ = other.i_entry_;
+  src_ = std::move(other.src_);
+  rules_ = std::move(other.rules_);
+  saved_ = std::move(other.saved_);
+  link_untouched_ = other.link_untouched_;
+  written_ = std::move(other.written_);
+  closed_ = other.closed_;
+  return *this;
+}
+
+bool Tree::kept(const std::string& branch_name) const {
+  bool keep{false};
+  for (const auto& [glob, keep_it] : rules_) {
+    if (fnmatch(glob.c_str(), branch_name.c_str(), 0) == 0) keep = keep_it;
+  }
+  return keep;
+}
+
+void Tree::copy_untouched(const std::vector<std::string>& written) {
+  for (const auto& [name, _type] : reader_->availableObjects()) {
+    if (std::find(written.begin(), written.end(), name) != written.end() or
+        not kept(name)) {
+      continue;
+    }
+    reader_->copy(name, saved_, *writer_, link_untouched_);
+  }
+}
+
+Tree Tree::copy_for(const EntryRange& range) const {
+  // opening the file needs to be serialized with any other
+  // threads (e.g. our prefetcher) using HDF5
+  auto lock = hdf5_lock();
+  Tree t(src_, {"", ""});
+  t.range_ = range;
+  t.i_entry_ = range.begin;
+  t.reader_->setReadBufferSize(reader_->getReadBufferSize());
+  t.reader_->setPrefetch(reader_->getPrefetcher() != nullptr);
+  t.reader_->setDecompressor(reader_->getDecompressor());
+  return t;
+}
+
+Tree Tree::copy_inputs() const {
+  Tree t = copy_for({i_entry_, range_.end});
+  for (auto* br : inputs_) {
+    auto& copy = t.branches_[br->name()];
+    copy = br->sprout();
+    copy->attach(*t.reader_);
+    if (t.i_entry_ > 0) copy->seek(t.i_entry_);
+    t.inputs_.push_back(copy.get());
+  }
+  return t;
+}
+
+Tree Tree::detached_copy() const {
+  Tree t({"", ""}, {"", ""});
+  for (const auto& [name, br] : branches_) t.branches_[name] = br->sprout();
+  return t;
 }
 
 Tree::Tree(const std::pair<std::string, std::string>& src,
            const std::pair<std::string, std::string>& dest) {
   bool reading = (not src.first.empty());
   bool writing = (not dest.first.empty());
-  bool inplace_ = (src.first == dest.first);
+  inplace_ = reading and writing and (src.first == dest.first);
 
-  if (inplace_ and src.first != dest.first) {
+  if (inplace_ and src.second != dest.second) {
     throw HDTreeException(
         "HDTree does not support copying a HDTree to a new location within the "
         "same file.",
@@ -65,6 +532,8 @@ Tree::Tree(const std::pair<std::string, std::string>& src,
           );
     }
     entries_ = reader_->entries();
+    range_ = {0, *entries_};
+    src_ = src;
   }
 
   if (writing) {
@@ -77,7 +546,7 @@ Tree::Tree(const std::pair<std::string, std::string>& src,
     } catch (const HighFive::GroupException& e) {
       std::stringstream msg;
       msg << "HDTree '" << dest.second << "' ";
-      if (inplace) msg << "does not exist";
+      if (inplace_) msg << "does not exist";
       else msg << "already exists";
       msg << " within '" << dest.first << "'.";
       throw hdtree::HDTreeException(msg.str());
@@ -1,6 +1,8 @@
 #include "hdtree/Writer.h"
 
+#include "hdtree/Concurrency.h"
 #include "hdtree/Constants.h"
+#include "hdtree/KeyIndex.h"
 #include "hdtree/Version.h"
 
 namespace hdtree {
@@ -8,6 +10,12 @@ namespace hdtree {
 Writer::Writer(const std::pair<std::string, std::string>& file_tree_path,
                bool inplace, int rows_per_chunk, bool shuffle,
                int compression_level)
+    : Writer(file_tree_path, inplace, rows_per_chunk, shuffle,
+             compression_level, hdf5_lock()) {}
+
+Writer::Writer(const std::pair<std::string, std::string>& file_tree_path,
+               bool inplace, int rows_per_chunk, bool shuffle,
+               int compression_level, std::unique_lock<std::recursive_mutex>)
     : file_{file_tree_path.first,
             inplace ? HighFive::File::ReadWrite
                     : (HighFive::File::Create | HighFive::File::Truncate)},
@@ -22,6 +30,8 @@ Writer::Writer(const std::pair<std::string, std::string>& file_tree_path,
   create_props_.add(HighFive::Chunking({rows_per_chunk_}));
   if (shuffle) create_props_.add(HighFive::Shuffle());
   create_props_.add(HighFive::Deflate(compression_level));
+  filters_.shuffle = shuffle;
+  filters_.deflate_level = compression_level;
 
   if (not inplace) {
     tree_.createAttribute(constants::VERS_ATTR_NAME, 1 /*HDTREE_VERSION*/);
@@ -30,23 +40,69 @@ Writer::Writer(const std::pair<std::string, std::string>& file_tree_path,
   }
 }
 
-Writer::~Writer() { this->flush(); }
+Writer::~Writer() {
+  try {
+    this->flush();
+  } catch (...) {
+    // nowhere to report errors, those that want them call flush
+  }
+}
+
+void Writer::setWriteBehind(bool write_behind, std::size_t max_queued) {
+  if (flusher_) flusher_->wait();
+  if (write_behind) {
+    flusher_ = std::make_shared<ThreadPool>(1, max_queued);
+  } else {
+    flusher_.reset();
+  }
+}
+
+void Writer::setCompressionThreads(std::size_t n_threads) {
+  if (compressor_) compressor_->wait();
+  if (n_threads > 0) {
+    compressor_ = std::make_shared<ThreadPool>(n_threads, 2 * n_threads);
+  } else {
+    compressor_.reset();
+  }
+}
+
+void Writer::deferError(std::exception_ptr error) {
+  if (not error_) error_ = error;
+}
 
 void Writer::flush() {
+  // wait for the background writes to finish before locking
+  // since they need the lock to finish
+  if (compressor_) compressor_->wait();
+  if (flusher_) flusher_->wait();
+  if (error_) {
+    std::exception_ptr error;
+    std::swap(error, error_);
+    std::rethrow_exception(error);
+  }
+  auto lock = hdf5_lock();
+  for (const auto& [branch_name, zones] : zones_) saveZones(branch_name, zones);
+  zones_.clear();
   if (tree_.hasAttribute(constants::SIZE_NAME)) {
-    tree_.getAttribute(constants::SIZE_NAME).write(entries_);
+    // a tree updated in place without saving any entries
+    // (e.g. only building an index) keeps its size
+    if (entries_ > 0) tree_.getAttribute(constants::SIZE_NAME).write(entries_);
   } else {
     tree_.createAttribute(constants::SIZE_NAME, entries_);
   }
   file_.flush();
 }
 
-const std::string& Writer::name() const { return file_.getName(); }
+const std::string& Writer::name() const {
+  auto lock = hdf5_lock();
+  return file_.getName();
+}
 
-void Writer::increment() { entries_++; }
+void Writer::increment(std::size_t n) { entries_ += n; }
 
 void Writer::structure(const std::string& branch_name,
                        const std::pair<std::string, int>& type) {
+  auto lock = hdf5_lock();
   if (tree_.exist(branch_name)) {
     // group already been written to, check that we are the same
     auto grp = tree_.getGroup(branch_name);
@@ -72,9 +128,96 @@ void Writer::structure(const std::string& branch_name,
   }
 }
 
+void Writer::saveZones(const std::string& branch_name,
+                       const std::vector<double>& zones) {
+  if (zones.empty()) return;
+  auto lock = hdf5_lock();
+  for (auto slash = branch_name.find('/'); slash != std::string::npos;
+       slash = branch_name.find('/', slash + 1)) {
+    auto parent = branch_name.substr(0, slash);
+    if (tree_.exist(parent) and
+        tree_.getGroup(parent).hasAttribute(constants::TYPE_ATTR_NAME)) {
+      return;
+    }
+  }
+  auto path = constants::ZONES_NAME + "/" + branch_name;
+  if (tree_.exist(path)) return;
+  std::size_t n_zones{zones.size() / 3};
+  auto ds = tree_.createDataSet(path, HighFive::DataSpace({n_zones, 3}),
+                                HighFive::create_datatype<double>());
+  ds.select({0, 0}, {n_zones, 3})
+      .write_raw(zones.data(), HighFive::create_datatype<double>());
+}
+
+void Writer::saveIndex(const std::string& name,
+                       const std::vector<std::int64_t>& rows,
+                       std::size_t n_columns) {
+  auto lock = hdf5_lock();
+  std::size_t n_rows{rows.size() / n_columns};
+  auto path = constants::INDEX_NAME + "/" + name;
+  HighFive::DataSet ds;
+  if (tree_.exist(path)) {
+    ds = tree_.getDataSet(path);
+    ds.resize({n_rows, n_columns});
+  } else {
+    HighFive::DataSetCreateProps props;
+    props.add(HighFive::Chunking({KeyIndex::BLOCK_ROWS, n_columns}));
+    if (filters_.shuffle) props.add(HighFive::Shuffle());
+    if (filters_.deflate_level >= 0) {
+      props.add(HighFive::Deflate(filters_.deflate_level));
+    }
+    ds = tree_.createDataSet(
+        path,
+        HighFive::DataSpace({n_rows, n_columns},
+                            {HighFive::DataSpace::UNLIMITED, n_columns}),
+        HighFive::create_datatype<std::int64_t>(), props);
+  }
+  if (n_rows == 0) return;
+  ds.select({0, 0}, {n_rows, n_columns})
+      .write_raw(rows.data(), HighFive::create_datatype<std::int64_t>());
+}
+
+void Writer::addZones(const std::string& branch_name,
+                      std::vector<double> zones) {
+  zones_.emplace_back(branch_name, std::move(zones));
+}
+
 HighFive::DataSet Writer::createDataSet(const std::string& branch_name,
                                         HighFive::DataType data_type) {
+  auto lock = hdf5_lock();
   return tree_.createDataSet(branch_name, space_, data_type, create_props_);
 }
 
+HighFive::DataSet Writer::createVirtualDataSet(
+    const std::string& branch_name, const HighFive::DataType& data_type,
+    std::size_t n_rows, const std::pair<std::string, std::string>& source,
+    std::size_t source_begin) {
+  auto lock = hdf5_lock();
+  hsize_t n{n_rows}, begin{source_begin}, src_n{source_begin + n_rows};
+  hid_t space = H5Screate_simple(1, &n, nullptr);
+  hid_t src_space = H5Screate_simple(1, &src_n, nullptr);
+  H5Sselect_hyperslab(src_space, H5S_SELECT_SET, &begin, nullptr, &n,
+                      nullptr);
+  hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+  hid_t lcpl = H5Pcreate(H5P_LINK_CREATE);
+  H5Pset_create_intermediate_group(lcpl, 1);
+  hid_t ds{-1};
+  if (H5Pset_virtual(dcpl, space, source.first.c_str(), source.second.c_str(),
+                     src_space) >= 0) {
+    ds = H5Dcreate2(tree_.getId(), branch_name.c_str(), data_type.getId(),
+                    space, lcpl, dcpl, H5P_DEFAULT);
+  }
+  H5Pclose(lcpl);
+  H5Pclose(dcpl);
+  H5Sclose(src_space);
+  H5Sclose(space);
+  if (ds < 0) {
+    throw HDTreeException("HDTreeBadLink: Unable to create virtual data set " +
+                          branch_name + " reading from " + source.second +
+                          " in '" + source.first + "'.");
+  }
+  H5Dclose(ds);
+  return tree_.getDataSet(branch_name);
+}
+
 }  // namespace hdtree
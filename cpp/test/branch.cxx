@@ -312,4 +312,85 @@ BOOST_AUTO_TEST_CASE(read, *boost::unit_test::depends_on("branch/write")) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(chunked) {
+  static const std::size_t n_entries{1000};
+  {
+    hdtree::Writer f({"chunked_" + filename, "test"}, false, 64);
+    hdtree::Branch<int> int_ds("int");
+    hdtree::Branch<bool> bool_ds("bool");
+    hdtree::Branch<std::vector<double>> vector_double_ds("vector_double");
+    int_ds.attach(f);
+    bool_ds.attach(f);
+    vector_double_ds.attach(f);
+    for (std::size_t i_entry{0}; i_entry < n_entries; i_entry++) {
+      BOOST_CHECK(save(int_ds, int(i_entry)));
+      BOOST_CHECK(save(bool_ds, i_entry % 3 == 0));
+      BOOST_CHECK(save(vector_double_ds,
+                       std::vector<double>(i_entry % 7, double(i_entry))));
+      f.increment();
+    }
+  }
+
+  hdtree::Reader f({"chunked_" + filename, "test"});
+  // smaller than a single chunk so we should still get one chunk at a time
+  f.setReadBufferSize(100);
+  BOOST_CHECK(f.getReadBufferRows(f.getDataSet("int")) == 64);
+  f.setReadBufferSize(64 * sizeof(int) * 3 + 10);
+  BOOST_CHECK(f.getReadBufferRows(f.getDataSet("int")) == 64 * 3);
+
+  hdtree::Branch<int> int_ds("int");
+  hdtree::Branch<bool> bool_ds("bool");
+  hdtree::Branch<std::vector<double>> vector_double_ds("vector_double");
+  int_ds.attach(f);
+  bool_ds.attach(f);
+  vector_double_ds.attach(f);
+  for (std::size_t i_entry{0}; i_entry < n_entries; i_entry++) {
+    BOOST_CHECK(load(int_ds, int(i_entry)));
+    BOOST_CHECK(load(bool_ds, i_entry % 3 == 0));
+    BOOST_CHECK(load(vector_double_ds,
+                     std::vector<double>(i_entry % 7, double(i_entry))));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(packed_bools) {
+  // not a multiple of eight so the last byte is partially filled
+  static const std::size_t n_entries{1001};
+  {
+    hdtree::Writer f({"packed_" + filename, "test"}, false, 16, true, 6);
+    f.setPackBools(true);
+    hdtree::Branch<bool> bool_ds("bool");
+    hdtree::Branch<std::vector<bool>> vector_bool_ds("vector_bool");
+    bool_ds.attach(f);
+    vector_bool_ds.attach(f);
+    for (std::size_t i_entry{0}; i_entry < n_entries; i_entry++) {
+      std::vector<bool> flags(i_entry % 5);
+      for (std::size_t i{0}; i < flags.size(); i++)
+        flags[i] = (i_entry + i) % 2;
+      BOOST_CHECK(save(bool_ds, i_entry % 3 == 0));
+      BOOST_CHECK(save(vector_bool_ds, flags));
+      f.increment();
+    }
+  }
+
+  for (std::size_t n_threads : {0, 2}) {
+    hdtree::Reader f({"packed_" + filename, "test"});
+    f.setDecompressionThreads(n_threads);
+    BOOST_CHECK(f.getDataSetType("bool") ==
+                HighFive::create_datatype<std::uint8_t>());
+    BOOST_CHECK(f.getDataSet("bool").getDimensions().at(0) ==
+                (n_entries + 7) / 8);
+    hdtree::Branch<bool> bool_ds("bool");
+    hdtree::Branch<std::vector<bool>> vector_bool_ds("vector_bool");
+    bool_ds.attach(f);
+    vector_bool_ds.attach(f);
+    for (std::size_t i_entry{0}; i_entry < n_entries; i_entry++) {
+      std::vector<bool> flags(i_entry % 5);
+      for (std::size_t i{0}; i < flags.size(); i++)
+        flags[i] = (i_entry + i) % 2;
+      BOOST_CHECK(load(bool_ds, i_entry % 3 == 0));
+      BOOST_CHECK(load(vector_bool_ds, flags));
+    }
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -5,11 +5,14 @@
  * and all different types of data from atomic types to containers of user
  * classes are serializable.
  */
+#include <filesystem>
+
 #include <boost/test/tools/interface.hpp>
 #define BOOST_TEST_DYN_LINK
 #include <boost/test/unit_test.hpp>
 #include <highfive/H5Easy.hpp>
 
+#include "hdtree/Merge.h"
 #include "hdtree/Tree.h"
 
 static std::string filename{"tree.h5"};
@@ -60,4 +63,1156 @@ BOOST_AUTO_TEST_CASE(read, *boost::unit_test::depends_on("tree/copy")) {
   });
 }
 
+BOOST_AUTO_TEST_CASE(inplace_get_write) {
+  std::string inplace_file{"inplace_get_" + filename};
+  {
+    hdtree::Tree t = hdtree::Tree::save(inplace_file, "test");
+    auto& b = t.branch<double>("double");
+    for (double v : doubles) {
+      *b = v;
+      t.save();
+    }
+  }
+  {
+    // branches already in the file are not created again
+    hdtree::Tree t = hdtree::Tree::inplace(inplace_file, "test");
+    auto& b = t.get<double>("double", true);
+    auto& b2 = t.branch<double>("double_sq");
+    BOOST_CHECK_NO_THROW(t.for_each([&]() { *b2 = (*b) * (*b); }));
+  }
+  {
+    hdtree::Tree t = hdtree::Tree::load(inplace_file, "test");
+    auto& b = t.get<double>("double");
+    auto& b2 = t.get<double>("double_sq");
+    std::size_t i{0};
+    t.for_each([&]() {
+      double v = doubles.at(i++);
+      BOOST_CHECK(*b == v);
+      BOOST_CHECK(*b2 == v * v);
+    });
+    BOOST_CHECK(i == doubles.size());
+  }
+  BOOST_CHECK_THROW(
+      hdtree::Tree::transform({inplace_file, "test"}, {inplace_file, "other"}),
+      hdtree::HDTreeException);
+}
+
+BOOST_AUTO_TEST_CASE(inplace_unsaved,
+                     *boost::unit_test::depends_on("tree/inplace_get_write")) {
+  std::string inplace_file{"inplace_get_" + filename};
+  {
+    // only reading a tree opened in place saves no entries
+    hdtree::Tree t = hdtree::Tree::inplace(inplace_file, "test");
+    auto& b = t.get<double>("double");
+    t.load();
+    BOOST_CHECK(*b == doubles.at(0));
+  }
+  hdtree::Tree t = hdtree::Tree::load(inplace_file, "test");
+  auto& b = t.get<double>("double");
+  std::size_t i{0};
+  t.for_each([&]() { BOOST_CHECK(*b == doubles.at(i++)); });
+  BOOST_CHECK(i == doubles.size());
+}
+
+BOOST_AUTO_TEST_CASE(prefetch) {
+  static const std::size_t n_entries{10000};
+  {
+    hdtree::Tree t = hdtree::Tree::save("prefetch_" + filename, "test");
+    auto& i_entry = t.branch<std::size_t>("i_entry");
+    auto& nums = t.branch<std::vector<double>>("nums");
+    for (std::size_t i{0}; i < n_entries; ++i) {
+      *i_entry = i;
+      nums->resize(i % 5, 2. * i);
+      t.save();
+    }
+  }
+
+  hdtree::Tree t = hdtree::Tree::load("prefetch_" + filename, "test");
+  // small buffers so we refill (and prefetch) many times
+  t.set_read_buffer_size(1024);
+  t.set_prefetch(true);
+  auto& i_entry = t.get<std::size_t>("i_entry");
+  auto& nums = t.get<std::vector<double>>("nums");
+  std::size_t i{0};
+  t.for_each([&]() {
+    BOOST_CHECK(*i_entry == i);
+    BOOST_CHECK(*nums == std::vector<double>(i % 5, 2. * i));
+    ++i;
+  });
+  BOOST_CHECK(i == n_entries);
+}
+
+static const std::size_t n_buffered_entries{25000};
+
+BOOST_AUTO_TEST_CASE(write_behind) {
+  {
+    hdtree::Tree t = hdtree::Tree::save("buffered_" + filename, "test");
+    t.set_write_behind(true, 2);
+    auto& i_entry = t.branch<std::size_t>("i_entry");
+    auto& nums = t.branch<std::vector<double>>("nums");
+    for (std::size_t i{0}; i < n_buffered_entries; ++i) {
+      *i_entry = i;
+      nums->resize(i % 5, 2. * i);
+      t.save();
+    }
+    BOOST_CHECK_NO_THROW(t.close());
+  }
+
+  hdtree::Tree t = hdtree::Tree::load("buffered_" + filename, "test");
+  auto& i_entry = t.get<std::size_t>("i_entry");
+  auto& nums = t.get<std::vector<double>>("nums");
+  std::size_t i{0};
+  t.for_each([&]() {
+    BOOST_CHECK(*i_entry == i);
+    BOOST_CHECK(*nums == std::vector<double>(i % 5, 2. * i));
+    ++i;
+  });
+  BOOST_CHECK(i == n_buffered_entries);
+}
+
+BOOST_AUTO_TEST_CASE(view, *boost::unit_test::depends_on("tree/write_behind")) {
+  hdtree::Tree t = hdtree::Tree::load("buffered_" + filename, "test");
+  // small buffers so some entries span buffer refills
+  t.set_read_buffer_size(1024);
+  t.set_prefetch(true);
+  auto& nums = t.get_view<double>("nums");
+  std::size_t i{0};
+  t.for_each([&]() {
+    BOOST_CHECK(*nums == std::vector<double>(i % 5, 2. * i));
+    ++i;
+  });
+  BOOST_CHECK(i == n_buffered_entries);
+}
+
+BOOST_AUTO_TEST_CASE(seek, *boost::unit_test::depends_on("tree/write_behind")) {
+  hdtree::Tree t = hdtree::Tree::load("buffered_" + filename, "test");
+  // small buffers so seeking crosses many chunks
+  t.set_read_buffer_size(1024);
+  t.set_prefetch(true);
+  auto& i_entry = t.get<std::size_t>("i_entry");
+  auto& nums = t.get<std::vector<double>>("nums");
+  for (std::size_t i : {17000ul, 3ul, 4ul, 128ul, 24999ul, 0ul, 12345ul}) {
+    t.load(i);
+    BOOST_CHECK(*i_entry == i);
+    BOOST_CHECK(*nums == std::vector<double>(i % 5, 2. * i));
+  }
+  // sequential loading continues from where we seeked to
+  t.load();
+  BOOST_CHECK(*i_entry == 12346);
+  BOOST_CHECK(*nums == std::vector<double>(12346 % 5, 2. * 12346));
+  BOOST_CHECK_NO_THROW(t.seek(n_buffered_entries));
+  BOOST_CHECK_THROW(t.seek(n_buffered_entries + 1), hdtree::HDTreeException);
+}
+
+BOOST_AUTO_TEST_CASE(shards,
+                     *boost::unit_test::depends_on("tree/write_behind")) {
+  const std::size_t n_shards{7};
+  std::size_t n_entries{0};
+  for (std::size_t i_shard{0}; i_shard < n_shards; ++i_shard) {
+    hdtree::Tree t = hdtree::Tree::load("buffered_" + filename, "test",
+                                        i_shard, n_shards);
+    t.set_read_buffer_size(1024);
+    auto& i_entry = t.get<std::size_t>("i_entry");
+    auto& nums = t.get<std::vector<double>>("nums");
+    std::size_t i{t.range().begin};
+    BOOST_CHECK(i == n_entries);
+    t.for_each([&]() {
+      BOOST_CHECK(*i_entry == i);
+      BOOST_CHECK(*nums == std::vector<double>(i % 5, 2. * i));
+      ++i;
+    });
+    BOOST_CHECK(i == t.range().end);
+    n_entries += t.range().size();
+  }
+  BOOST_CHECK(n_entries == n_buffered_entries);
+
+  hdtree::Tree t =
+      hdtree::Tree::load("buffered_" + filename, "test", {100, 200});
+  auto& i_entry = t.get<std::size_t>("i_entry");
+  std::size_t i{150};
+  t.for_each(150, 160, [&]() { BOOST_CHECK(*i_entry == i++); });
+  BOOST_CHECK(i == 160);
+  // the loop over the rest of the range continues from where we are
+  t.for_each([&]() { BOOST_CHECK(*i_entry == i++); });
+  BOOST_CHECK(i == 200);
+  BOOST_CHECK_THROW(t.for_each(150, 250, []() {}), hdtree::HDTreeException);
+  BOOST_CHECK_THROW(t.for_each(50, 150, []() {}), hdtree::HDTreeException);
+  BOOST_CHECK_THROW(
+      hdtree::Tree::load("buffered_" + filename, "test", {0, 30000}),
+      hdtree::HDTreeException);
+
+  // trees that are writing can't seek, so they continue as well
+  hdtree::Tree tr = hdtree::Tree::transform(
+      {"buffered_" + filename, "test"}, {"continued_loop_" + filename, "test"});
+  auto& copied = tr.get<std::size_t>("i_entry", true);
+  tr.load();
+  tr.save();
+  i = 1;
+  tr.for_each([&]() { BOOST_CHECK(*copied == i++); });
+  BOOST_CHECK(i == n_buffered_entries);
+}
+
+namespace {
+/// sum the entry indices and the sizes of the vectors
+struct SumEntries {
+  const hdtree::Branch<std::size_t>& i_entry;
+  const hdtree::Branch<std::vector<double>>& nums;
+  std::size_t entries{0};
+  std::size_t sum{0};
+  std::size_t n_nums{0};
+  std::size_t n_wrong{0};
+  // Boost.Test assertions are not thread safe, so we count mistakes
+  void operator()() {
+    if (not(*nums == std::vector<double>(*i_entry % 5, 2. * (*i_entry))))
+      n_wrong++;
+    entries++;
+    sum += *i_entry;
+    n_nums += nums->size();
+  }
+};
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(parallel_for_each,
+                     *boost::unit_test::depends_on("tree/write_behind")) {
+  hdtree::Tree t = hdtree::Tree::load("buffered_" + filename, "test");
+  t.set_read_buffer_size(1024);
+  t.set_prefetch(true);
+  std::size_t entries{0}, sum{0}, n_nums{0}, n_wrong{0};
+  t.parallel_for_each(
+      [](hdtree::Tree& worker) {
+        return SumEntries{worker.get<std::size_t>("i_entry"),
+                          worker.get<std::vector<double>>("nums")};
+      },
+      [&](SumEntries& s) {
+        entries += s.entries;
+        sum += s.sum;
+        n_nums += s.n_nums;
+        n_wrong += s.n_wrong;
+      },
+      4);
+  BOOST_CHECK(entries == n_buffered_entries);
+  BOOST_CHECK(sum == n_buffered_entries * (n_buffered_entries - 1) / 2);
+  BOOST_CHECK(n_nums == 2 * n_buffered_entries);
+  BOOST_CHECK(n_wrong == 0);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_transform,
+                     *boost::unit_test::depends_on("tree/write_behind")) {
+  for (bool parallel : {false, true}) {
+    hdtree::Tree t = hdtree::Tree::transform(
+        {"buffered_" + filename, "test"},
+        {(parallel ? "parallel_" : "serial_") + filename, "test"});
+    // write the entry indices so the outputs can be checked against them
+    t.get<std::size_t>("i_entry", true);
+    auto& nums = t.get<std::vector<double>>("nums");
+    auto& sum = t.branch<double>("sum");
+    auto& doubled = t.branch<std::vector<double>>("doubled");
+    if (parallel) {
+      t.parallel_transform(
+          [](hdtree::Tree& entry) {
+            auto& nums = entry.get<std::vector<double>>("nums");
+            auto& sum = entry.branch<double>("sum");
+            auto& doubled = entry.branch<std::vector<double>>("doubled");
+            return [&]() {
+              for (double num : *nums) {
+                *sum += num;
+                doubled->push_back(2 * num);
+              }
+            };
+          },
+          4, 16);
+    } else {
+      t.for_each([&]() {
+        for (double num : *nums) {
+          *sum += num;
+          doubled->push_back(2 * num);
+        }
+      });
+    }
+  }
+
+  hdtree::Tree serial = hdtree::Tree::load("serial_" + filename, "test");
+  auto& serial_sum = serial.get<double>("sum");
+  auto& serial_doubled = serial.get<std::vector<double>>("doubled");
+  hdtree::Tree parallel = hdtree::Tree::load("parallel_" + filename, "test");
+  auto& i_entry = parallel.get<std::size_t>("i_entry");
+  auto& parallel_sum = parallel.get<double>("sum");
+  auto& parallel_doubled = parallel.get<std::vector<double>>("doubled");
+  std::size_t i{0};
+  parallel.for_each([&]() {
+    serial.load();
+    BOOST_CHECK(*i_entry == i);
+    BOOST_CHECK(*parallel_sum == *serial_sum);
+    BOOST_CHECK(*parallel_doubled == *serial_doubled);
+    BOOST_CHECK(*parallel_doubled == std::vector<double>(i % 5, 4. * i));
+    ++i;
+  });
+  BOOST_CHECK(i == n_buffered_entries);
+
+  // the transform continues from the entries that were already done
+  {
+    hdtree::Tree t = hdtree::Tree::transform(
+        {"buffered_" + filename, "test"}, {"continued_" + filename, "test"});
+    auto& i_entry = t.get<std::size_t>("i_entry");
+    auto& copied = t.branch<std::size_t>("copied");
+    t.for_each(0, 20000, [&]() { *copied = *i_entry; });
+    t.parallel_transform(
+        [](hdtree::Tree& entry) {
+          auto& i_entry = entry.get<std::size_t>("i_entry");
+          auto& copied = entry.branch<std::size_t>("copied");
+          return [&]() { *copied = *i_entry; };
+        },
+        4, 16);
+  }
+  hdtree::Tree continued =
+      hdtree::Tree::load("continued_" + filename, "test");
+  auto& copied = continued.get<std::size_t>("copied");
+  i = 0;
+  continued.for_each([&]() { BOOST_CHECK(*copied == i++); });
+  BOOST_CHECK(i == n_buffered_entries);
+}
+
+BOOST_AUTO_TEST_CASE(pipelined_for_each,
+                     *boost::unit_test::depends_on("tree/parallel_transform")) {
+  {
+    hdtree::Tree t = hdtree::Tree::transform(
+        {"buffered_" + filename, "test"}, {"pipelined_" + filename, "test"});
+    t.set_read_buffer_size(1024);
+    t.set_prefetch(true);
+    t.set_write_behind(true);
+    auto& nums = t.get<std::vector<double>>("nums");
+    auto& sum = t.branch<double>("sum");
+    auto& doubled = t.branch<std::vector<double>>("doubled");
+    t.pipelined_for_each(
+        [&]() {
+          for (double num : *nums) {
+            *sum += num;
+            doubled->push_back(2 * num);
+          }
+        },
+        4);
+  }
+
+  hdtree::Tree serial = hdtree::Tree::load("serial_" + filename, "test");
+  auto& serial_sum = serial.get<double>("sum");
+  auto& serial_doubled = serial.get<std::vector<double>>("doubled");
+  hdtree::Tree pipelined = hdtree::Tree::load("pipelined_" + filename, "test");
+  auto& sum = pipelined.get<double>("sum");
+  auto& doubled = pipelined.get<std::vector<double>>("doubled");
+  std::size_t i{0};
+  pipelined.pipelined_for_each([&]() {
+    serial.load();
+    BOOST_CHECK(*sum == *serial_sum);
+    BOOST_CHECK(*doubled == *serial_doubled);
+    ++i;
+  });
+  BOOST_CHECK(i == n_buffered_entries);
+
+  // the pipeline continues from where we seeked to
+  hdtree::Tree t = hdtree::Tree::load("buffered_" + filename, "test");
+  auto& i_entry = t.get<std::size_t>("i_entry");
+  t.seek(20000);
+  i = 20000;
+  t.pipelined_for_each([&]() { BOOST_CHECK(*i_entry == i++); }, 4);
+  BOOST_CHECK(i == n_buffered_entries);
+}
+
+BOOST_AUTO_TEST_CASE(batches,
+                     *boost::unit_test::depends_on("tree/write_behind")) {
+  for (std::size_t i_shard : {0ul, 2ul}) {
+    hdtree::Tree t =
+        hdtree::Tree::load("buffered_" + filename, "test", i_shard, 3);
+    // small buffers so some batches span buffer refills
+    t.set_read_buffer_size(1024);
+    auto& i_entry = t.get_batch<std::size_t>("i_entry");
+    auto& nums = t.get_batch<double>("nums");
+    std::size_t i{t.range().begin}, n_wrong{0};
+    t.for_each_batch(1000, [&](const hdtree::EntryRange& entries) {
+      BOOST_CHECK(entries.begin == i);
+      BOOST_CHECK(i_entry.size() == entries.size());
+      BOOST_CHECK(nums.size() == entries.size());
+      for (std::size_t j{0}; j < entries.size(); j++, i++) {
+        if (i_entry[j] != i or
+            not(nums.entry(j) == std::vector<double>(i % 5, 2. * i))) {
+          n_wrong++;
+        }
+      }
+    });
+    BOOST_CHECK(n_wrong == 0);
+    BOOST_CHECK(i == t.range().end);
+  }
+
+  // batches continue from where we seeked to
+  hdtree::Tree t = hdtree::Tree::load("buffered_" + filename, "test");
+  auto& i_entry = t.get_batch<std::size_t>("i_entry");
+  t.seek(24000);
+  std::size_t i{24000};
+  t.for_each_batch(300, [&](const hdtree::EntryRange& entries) {
+    BOOST_CHECK(entries.begin == i);
+    BOOST_CHECK(i_entry[0] == i);
+    i = entries.end;
+  });
+  BOOST_CHECK(i == n_buffered_entries);
+  // batches are not loaded entry by entry
+  t.seek(0);
+  BOOST_CHECK_THROW(t.for_each([]() {}), hdtree::HDTreeException);
+}
+
+BOOST_AUTO_TEST_CASE(columns,
+                     *boost::unit_test::depends_on("tree/write_behind")) {
+  hdtree::Tree t = hdtree::Tree::load("buffered_" + filename, "test");
+  std::vector<std::size_t> i_entry = t.column<std::size_t>("i_entry");
+  BOOST_CHECK(i_entry.size() == n_buffered_entries);
+  for (std::size_t i{0}; i < i_entry.size(); i++) {
+    BOOST_CHECK(i_entry[i] == i);
+  }
+  // values are converted to the requested type
+  std::vector<float> nums = t.column<float>("nums");
+  BOOST_CHECK(nums.size() == 2 * n_buffered_entries);
+  BOOST_CHECK(nums[0] == 2.f);
+  BOOST_CHECK(nums.back() == float(2. * (n_buffered_entries - 1)));
+
+  // chunks of a shard
+  hdtree::Tree shard =
+      hdtree::Tree::load("buffered_" + filename, "test", 1, 3);
+  auto column = shard.column_reader<double>("nums", 1000);
+  std::size_t i{shard.range().begin}, n_wrong{0}, n_values{0};
+  for (const std::vector<double>& chunk : column) {
+    std::size_t i_value{0};
+    for (std::size_t size : column.chunk_sizes()) {
+      if (size != i % 5) n_wrong++;
+      for (std::size_t j{0}; j < size; j++) {
+        if (chunk[i_value++] != 2. * i) n_wrong++;
+      }
+      i++;
+    }
+    if (i_value != chunk.size()) n_wrong++;
+    n_values += chunk.size();
+  }
+  BOOST_CHECK(n_wrong == 0);
+  BOOST_CHECK(i == shard.range().end);
+  BOOST_CHECK(n_values == column.size());
+}
+
+BOOST_AUTO_TEST_CASE(column_types) {
+  {
+    hdtree::Tree t = hdtree::Tree::save("column_types_" + filename, "test");
+    auto& text = t.branch<std::string>("text");
+    auto& flag = t.branch<bool>("flag");
+    t.set_flat_strings(true);
+    t.set_pack_bools(true);
+    auto& name = t.branch<std::string>("name");
+    auto& packed = t.branch<bool>("packed");
+    auto& map = t.branch<std::map<int, double>>("map");
+    auto& nums = t.branch<std::vector<double>>("nums");
+    for (std::size_t i{0}; i < 100; ++i) {
+      *text = *name = std::to_string(i);
+      *flag = *packed = (i % 3 == 0);
+      (*map)[int(i)] = 0.5 * i;
+      nums->assign(i % 3, 1.);
+      t.save();
+    }
+  }
+  hdtree::Tree t = hdtree::Tree::load("column_types_" + filename, "test");
+  BOOST_CHECK(t.column<double>("nums").size() == 99);
+  // only arithmetic branches and vectors of them are columns
+  for (const std::string name : {"text", "flag", "name", "packed", "map"}) {
+    BOOST_CHECK_THROW(t.column<double>(name), hdtree::HDTreeException);
+  }
+  BOOST_CHECK_THROW(t.reduce<double>("map"), hdtree::HDTreeException);
+}
+
+BOOST_AUTO_TEST_CASE(aggregates,
+                     *boost::unit_test::depends_on("tree/write_behind")) {
+  const std::size_t n{n_buffered_entries};
+  hdtree::Tree t = hdtree::Tree::load("buffered_" + filename, "test");
+  hdtree::Summary i_entry = t.reduce<double>("i_entry");
+  BOOST_CHECK(i_entry.count == n);
+  BOOST_CHECK(i_entry.sum == n * (n - 1) / 2.);
+  BOOST_CHECK(i_entry.min == 0.);
+  BOOST_CHECK(i_entry.max == n - 1.);
+
+  std::size_t count{0};
+  double sum{0.}, weighted{0.};
+  for (std::size_t i{0}; i < n; i++) {
+    count += i % 5;
+    sum += (i % 5) * 2. * i;
+    weighted += (i % 5) * 2. * i * i;
+  }
+  for (std::size_t n_threads : {1, 4}) {
+    hdtree::Summary nums = t.reduce<double>("nums", "", n_threads);
+    BOOST_CHECK(nums.count == count);
+    BOOST_CHECK(nums.sum == sum);
+    BOOST_CHECK(nums.max == 2. * (n - 1));
+    // one weight per entry is used for all of its values
+    nums = t.reduce<double>("nums", "i_entry", n_threads);
+    BOOST_CHECK(nums.count == count);
+    BOOST_CHECK(nums.sum == weighted);
+  }
+
+  hdtree::Histogram h =
+      t.histogram<double>("i_entry", hdtree::Axis(10, 0., 0.5 * n));
+  BOOST_CHECK(h.at(0) == 0.);
+  for (std::size_t i{1}; i <= 10; i++) BOOST_CHECK(h.at(i) == n / 20.);
+  BOOST_CHECK(h.at(11) == n / 2.);
+
+  hdtree::Histogram h2 =
+      t.histogram<float>("i_entry", "i_entry", hdtree::Axis(5, 0., 1. * n),
+                         hdtree::Axis(5, 0., 1. * n), "i_entry");
+  for (std::size_t i{1}; i <= 5; i++) {
+    BOOST_CHECK(h2.at(i, i) > 0.);
+    BOOST_CHECK(h2.at(i, 6 - i) == (i == 3 ? h2.at(i, i) : 0.));
+  }
+  hdtree::Axis unit(1, 0., 1.);
+  BOOST_CHECK_THROW(t.histogram<double>("i_entry", "nums", unit, unit),
+                    hdtree::HDTreeException);
+  BOOST_CHECK_THROW(hdtree::Axis(0, 0., 1.), hdtree::HDTreeException);
+}
+
+BOOST_AUTO_TEST_CASE(zone_maps,
+                     *boost::unit_test::depends_on("tree/write_behind")) {
+  {
+    // written in chunks of 10000 entries
+    hdtree::Tree t = hdtree::Tree::save("zones_" + filename, "test");
+    t.set_zone_maps(true);
+    auto& i_entry = t.branch<std::size_t>("i_entry");
+    auto& nums = t.branch<std::vector<double>>("nums");
+    for (std::size_t i{0}; i < n_buffered_entries; ++i) {
+      *i_entry = i;
+      nums->resize(i % 5, 2. * i);
+      t.save();
+    }
+  }
+  {
+    // zone maps are opt-in
+    hdtree::Tree t = hdtree::Tree::load("buffered_" + filename, "test");
+    BOOST_CHECK(t.select("i_entry", hdtree::Interval::less(0)).size() == 1);
+  }
+
+  hdtree::Tree t = hdtree::Tree::load("zones_" + filename, "test");
+  auto above = t.select("i_entry", hdtree::Interval::greater(15000));
+  BOOST_REQUIRE(above.size() == 1);
+  BOOST_CHECK(above[0].begin == 10000);
+  BOOST_CHECK(above[0].end == n_buffered_entries);
+  auto exact = t.select("i_entry", hdtree::Interval::equal(9999));
+  BOOST_REQUIRE(exact.size() == 1);
+  BOOST_CHECK(exact[0].end == 10000);
+  BOOST_CHECK(t.select("i_entry", hdtree::Interval::less(0)).empty());
+  BOOST_CHECK(t.select({{"i_entry", hdtree::Interval::less(5000)},
+                        {"i_entry", hdtree::Interval::greater(15000)}})
+                  .empty());
+  // vectors have no zone map so every entry may pass
+  auto all = t.select("nums", hdtree::Interval::less(0));
+  BOOST_REQUIRE(all.size() == 1);
+  BOOST_CHECK(all[0].size() == n_buffered_entries);
+
+  std::size_t n_selected{0};
+  auto& i_entry = t.get<std::size_t>("i_entry");
+  for (const auto& r : t.select("i_entry", hdtree::Interval::less(100))) {
+    t.for_each(r.begin, r.end, [&]() { n_selected += (*i_entry < 100); });
+  }
+  BOOST_CHECK(n_selected == 100);
+
+  // zones are clipped to the range of a shard
+  hdtree::Tree shard = hdtree::Tree::load("zones_" + filename, "test", 1, 3);
+  auto in_shard = shard.select("i_entry", hdtree::Interval::greater(15000));
+  BOOST_REQUIRE(in_shard.size() == 1);
+  BOOST_CHECK(in_shard[0].begin == 10000);
+  BOOST_CHECK(in_shard[0].end == shard.range().end);
+}
+
+BOOST_AUTO_TEST_CASE(move_assign) {
+  hdtree::Tree t = hdtree::Tree::save("moved_from_" + filename, "test");
+  t.set_zone_maps(true);
+  auto* x = &t.branch<double>("x");
+  for (std::size_t i{0}; i < 10; ++i) {
+    **x = 0.5 * i;
+    t.save();
+  }
+  // the old tree is finished before the new one is moved in
+  t = hdtree::Tree::save("moved_to_" + filename, "test");
+  x = &t.branch<double>("x");
+  for (std::size_t i{0}; i < 5; ++i) {
+    **x = 2. * i;
+    t.save();
+  }
+  t.close();
+
+  for (auto [name, n] : {std::make_pair("moved_from_", 10ul),
+                         std::make_pair("moved_to_", 5ul)}) {
+    hdtree::Tree r = hdtree::Tree::load(name + filename, "test");
+    BOOST_CHECK(r.range().size() == n);
+    BOOST_CHECK(r.column<double>("x").size() == n);
+  }
+  hdtree::Tree r = hdtree::Tree::load("moved_from_" + filename, "test");
+  BOOST_CHECK(r.select("x", hdtree::Interval::greater(10.)).empty());
+}
+
+BOOST_AUTO_TEST_CASE(key_index) {
+  const std::size_t n{10007};
+  {
+    hdtree::Tree t = hdtree::Tree::save("indexed_" + filename, "test");
+    auto& run = t.branch<int>("run");
+    auto& event = t.branch<long>("event");
+    auto& energy = t.branch<double>("energy");
+    auto& id = t.branch<std::uint64_t>("id");
+    auto& hash = t.branch<std::uint64_t>("hash");
+    for (std::size_t i{0}; i < n; ++i) {
+      *run = i % 3;
+      *event = (i * 7919) % 5000;
+      *energy = 0.5 * i;
+      *id = i;
+      *hash = (i == n - 1) ? std::numeric_limits<std::uint64_t>::max() : i;
+      t.save();
+    }
+  }
+  {
+    hdtree::Tree t = hdtree::Tree::inplace("indexed_" + filename, "test");
+    BOOST_CHECK_THROW(t.build_index({"energy"}), hdtree::HDTreeException);
+    // unsigned keys must fit into the signed index
+    BOOST_CHECK_THROW(t.build_index({"hash"}), hdtree::HDTreeException);
+    t.build_index({"id"});
+    t.build_index({"run", "event"});
+    t.build_index({"event"});
+  }
+
+  hdtree::Tree t = hdtree::Tree::load("indexed_" + filename, "test");
+  BOOST_CHECK_THROW(t.find({"energy"}, {0}), hdtree::HDTreeException);
+  auto& run = t.get<int>("run");
+  auto& event = t.get<long>("event");
+  auto& energy = t.get<double>("energy");
+  std::size_t n_wrong{0};
+  for (std::size_t i : {std::size_t{0}, std::size_t{1234}, n - 1}) {
+    long ev = (i * 7919) % 5000;
+    std::vector<std::size_t> expected;
+    for (std::size_t j{0}; j < n; j++) {
+      if (j % 3 == i % 3 and long((j * 7919) % 5000) == ev) {
+        expected.push_back(j);
+      }
+    }
+    auto found = t.find({"run", "event"}, {long(i % 3), ev});
+    BOOST_CHECK(found == expected);
+    for (std::size_t entry : t.find({"run", "event"}, {long(i % 3), ev})) {
+      t.load(entry);
+      if (*run != int(i % 3) or *event != ev or *energy != 0.5 * entry) {
+        n_wrong++;
+      }
+    }
+    BOOST_CHECK(t.find({"event"}, {ev}).size() >= found.size());
+  }
+  BOOST_CHECK(n_wrong == 0);
+  BOOST_CHECK(t.find({"run", "event"}, {3, 0}).empty());
+  BOOST_CHECK(t.find({"event"}, {-1}).empty());
+  BOOST_CHECK(t.find({"id"}, {1234}) == std::vector<std::size_t>{1234});
+}
+
+BOOST_AUTO_TEST_CASE(fill_columns) {
+  const std::size_t n_block{1000}, n_blocks{25};
+  {
+    hdtree::Tree t = hdtree::Tree::save("filled_" + filename, "test");
+    auto& x = t.branch<double>("x");
+    auto& hits = t.branch<std::vector<int>>("hits");
+    auto& name = t.branch<std::string>("name");
+    std::vector<double> xs(n_block);
+    std::vector<int> content;
+    std::vector<std::size_t> offsets(n_block + 1);
+    std::vector<std::string> names(n_block);
+    std::size_t i{0};
+    for (std::size_t i_block{0}; i_block < n_blocks; i_block++) {
+      if (i_block % 5 == 4) {
+        // entries saved one at a time mix with the filled ones
+        for (std::size_t j{0}; j < n_block; j++, i++) {
+          *x = 0.5 * i;
+          hits->assign(i % 3, int(i));
+          *name = std::to_string(i);
+          t.save();
+        }
+        continue;
+      }
+      content.clear();
+      for (std::size_t j{0}; j < n_block; j++, i++) {
+        xs[j] = 0.5 * i;
+        offsets[j] = content.size();
+        content.insert(content.end(), i % 3, int(i));
+        names[j] = std::to_string(i);
+      }
+      offsets[n_block] = content.size();
+      t.fill_column("x", xs.data(), n_block);
+      t.fill_column("hits", content.data(), offsets.data(), n_block);
+      BOOST_CHECK_THROW(t.save(n_block), hdtree::HDTreeException);
+      BOOST_CHECK_THROW(t.save(), hdtree::HDTreeException);
+      t.fill_column("name", names.data(), n_block);
+      t.save(n_block);
+    }
+    BOOST_CHECK_THROW(t.fill_column("x", names.data(), n_block),
+                      hdtree::HDTreeException);
+  }
+
+  hdtree::Tree t = hdtree::Tree::load("filled_" + filename, "test");
+  auto& x = t.get<double>("x");
+  auto& hits = t.get<std::vector<int>>("hits");
+  auto& name = t.get<std::string>("name");
+  std::size_t i{0}, n_wrong{0};
+  t.for_each([&]() {
+    if (*x != 0.5 * i) n_wrong++;
+    if (*hits != std::vector<int>(i % 3, int(i))) n_wrong++;
+    if (*name != std::to_string(i)) n_wrong++;
+    ++i;
+  });
+  BOOST_CHECK(n_wrong == 0);
+  BOOST_CHECK(i == n_block * n_blocks);
+}
+
+BOOST_AUTO_TEST_CASE(compression_threads) {
+  {
+    hdtree::Tree t = hdtree::Tree::save("compressed_" + filename, "test");
+    t.set_compression_threads(4);
+    auto& i_entry = t.branch<std::size_t>("i_entry");
+    auto& even = t.branch<bool>("even");
+    auto& name = t.branch<std::string>("name");
+    auto& nums = t.branch<std::vector<float>>("nums");
+    for (std::size_t i{0}; i < n_buffered_entries; ++i) {
+      *i_entry = i;
+      *even = (i % 2 == 0);
+      *name = std::to_string(i);
+      nums->resize(i % 5, 0.5f * i);
+      t.save();
+    }
+  }
+
+  hdtree::Tree t = hdtree::Tree::load("compressed_" + filename, "test");
+  auto& i_entry = t.get<std::size_t>("i_entry");
+  auto& even = t.get<bool>("even");
+  auto& name = t.get<std::string>("name");
+  auto& nums = t.get<std::vector<float>>("nums");
+  std::size_t i{0};
+  t.for_each([&]() {
+    BOOST_CHECK(*i_entry == i);
+    BOOST_CHECK(*even == (i % 2 == 0));
+    BOOST_CHECK(*name == std::to_string(i));
+    BOOST_CHECK(*nums == std::vector<float>(i % 5, 0.5f * i));
+    ++i;
+  });
+  BOOST_CHECK(i == n_buffered_entries);
+}
+
+BOOST_AUTO_TEST_CASE(decompression_threads,
+                     *boost::unit_test::depends_on("tree/compression_threads")) {
+  hdtree::Tree t = hdtree::Tree::load("compressed_" + filename, "test");
+  t.set_read_buffer_size(4096);
+  t.set_prefetch(true);
+  t.set_decompression_threads(4);
+  auto& i_entry = t.get<std::size_t>("i_entry");
+  auto& even = t.get<bool>("even");
+  auto& nums = t.get<std::vector<float>>("nums");
+  std::size_t i{0};
+  t.for_each([&]() {
+    BOOST_CHECK(*i_entry == i);
+    BOOST_CHECK(*even == (i % 2 == 0));
+    BOOST_CHECK(*nums == std::vector<float>(i % 5, 0.5f * i));
+    ++i;
+  });
+  BOOST_CHECK(i == n_buffered_entries);
+}
+
+BOOST_AUTO_TEST_CASE(flat_strings) {
+  auto tag = [](std::size_t i) { return std::string(i % 13, 'a' + i % 26); };
+  {
+    hdtree::Tree t = hdtree::Tree::save("flat_" + filename, "test");
+    t.set_flat_strings(true);
+    auto& name = t.branch<std::string>("name");
+    auto& tags = t.branch<std::vector<std::string>>("tags");
+    for (std::size_t i{0}; i < n_buffered_entries; ++i) {
+      *name = std::to_string(i);
+      tags->clear();
+      for (std::size_t j{0}; j < i % 4; ++j) tags->push_back(tag(i + j));
+      t.save();
+    }
+  }
+
+  {
+    // read flat strings and write them back out in the default layout
+    hdtree::Tree t = hdtree::Tree::transform({"flat_" + filename, "test"},
+                                             {"unflat_" + filename, "test"});
+    t.get<std::string>("name", true);
+    t.get<std::vector<std::string>>("tags", true);
+    t.for_each([]() {});
+  }
+
+  for (const std::string& file : {"flat_" + filename, "unflat_" + filename}) {
+    hdtree::Tree t = hdtree::Tree::load(file, "test");
+    auto& name = t.get<std::string>("name");
+    auto& tags = t.get<std::vector<std::string>>("tags");
+    std::size_t i{0};
+    t.for_each([&]() {
+      BOOST_CHECK(*name == std::to_string(i));
+      BOOST_CHECK(tags->size() == i % 4);
+      for (std::size_t j{0}; j < tags->size(); ++j)
+        BOOST_CHECK(tags->at(j) == tag(i + j));
+      ++i;
+    });
+    BOOST_CHECK(i == n_buffered_entries);
+  }
+
+  hdtree::Tree t = hdtree::Tree::load("flat_" + filename, "test");
+  BOOST_CHECK_THROW(t.get<std::string>("missing"), hdtree::HDTreeException);
+  // values can't be moved in bulk by branches without a file
+  std::vector<std::string> values(3);
+  hdtree::Branch<std::string> detached("name");
+  BOOST_CHECK_THROW(detached.load(values.data(), values.size()),
+                    hdtree::HDTreeException);
+  BOOST_CHECK_THROW(detached.save(values.data(), values.size()),
+                    hdtree::HDTreeException);
+}
+
+BOOST_AUTO_TEST_CASE(categorical) {
+  static const std::vector<std::string> labels = {"ECal", "HCal", "Tracker",
+                                                  "Trigger"};
+  {
+    hdtree::Tree t = hdtree::Tree::save("categorical_" + filename, "test");
+    auto& det = t.branch<hdtree::Categorical<std::string>>("detector");
+    auto& run = t.branch<hdtree::Categorical<int, std::uint8_t>>("run");
+    auto& too_many = t.branch<hdtree::Categorical<int, std::uint8_t>>("many");
+    for (std::size_t i{0}; i < n_buffered_entries; ++i) {
+      *det = labels.at(i % labels.size());
+      *run = 1000 + i / 10000;
+      // only the first 256 distinct values fit into the codes
+      *too_many = i % 256;
+      t.save();
+    }
+    BOOST_CHECK(det.code_of("HCal") == 1);
+    BOOST_CHECK(not det.code_of("Muon"));
+    *too_many = 256;
+    BOOST_CHECK_THROW(too_many.save(), hdtree::HDTreeException);
+  }
+
+  hdtree::Tree t = hdtree::Tree::load("categorical_" + filename, "test");
+  auto& det = t.get<hdtree::Categorical<std::string>>("detector");
+  auto& run = t.get<hdtree::Categorical<int, std::uint8_t>>("run");
+  BOOST_CHECK(det.dictionary()->size() == labels.size());
+  BOOST_CHECK(run.dictionary()->size() == 3);
+  auto tracker = det.code_of("Tracker");
+  BOOST_REQUIRE(tracker);
+  std::size_t i{0};
+  t.for_each([&]() {
+    BOOST_CHECK(det->value() == labels.at(i % labels.size()));
+    BOOST_CHECK((det->code() == *tracker) == (i % labels.size() == 2));
+    BOOST_CHECK(*run == int(1000 + i / 10000));
+    ++i;
+  });
+  BOOST_CHECK(i == n_buffered_entries);
+}
+
+BOOST_AUTO_TEST_CASE(merge) {
+  // one whole chunk, one and a bit chunks, and a few entries
+  const std::vector<std::size_t> sizes = {20000, 12345, 7};
+  std::vector<std::pair<std::string, std::string>> inputs;
+  std::size_t first{0};
+  for (std::size_t size : sizes) {
+    inputs.emplace_back("merge_" + std::to_string(first) + "_" + filename,
+                        "test");
+    hdtree::Tree t = hdtree::Tree::save(inputs.back().first, "test");
+    t.set_pack_bools(true);
+    t.set_zone_maps(true);
+    auto& i_entry = t.branch<long>("i_entry");
+    auto& hits = t.branch<std::vector<int>>("hits");
+    auto& even = t.branch<bool>("even");
+    auto& name = t.branch<std::string>("name");
+    for (std::size_t i{first}; i < first + size; ++i) {
+      *i_entry = i;
+      hits->assign(i % 4, int(i));
+      *even = (i % 2 == 0);
+      *name = std::to_string(i);
+      t.save();
+    }
+    first += size;
+  }
+  {
+    hdtree::Tree t = hdtree::Tree::save(inputs.front().first + ".bad", "test");
+    t.branch<double>("i_entry");
+    *t.branch<double>("x") = 1.;
+    t.save();
+  }
+
+  BOOST_CHECK_THROW(
+      hdtree::merge({inputs.front(), {inputs.front().first + ".bad", "test"}},
+                    {"merged_bad_" + filename, "test"}),
+      hdtree::HDTreeException);
+  BOOST_CHECK(hdtree::merge(inputs, {"merged_" + filename, "test"}, 2) ==
+              first);
+
+  hdtree::Tree t = hdtree::Tree::load("merged_" + filename, "test");
+  auto& i_entry = t.get<long>("i_entry");
+  auto& hits = t.get<std::vector<int>>("hits");
+  auto& even = t.get<bool>("even");
+  auto& name = t.get<std::string>("name");
+  std::size_t i{0}, n_wrong{0};
+  t.for_each([&]() {
+    if (*i_entry != long(i) or hits->size() != i % 4 or
+        (not hits->empty() and hits->front() != int(i)) or
+        *even != (i % 2 == 0) or *name != std::to_string(i)) {
+      n_wrong++;
+    }
+    ++i;
+  });
+  BOOST_CHECK(i == first);
+  BOOST_CHECK(n_wrong == 0);
+
+  // the zone maps of the inputs are concatenated
+  auto last = t.select("i_entry", hdtree::Interval::greater_equal(32345));
+  BOOST_CHECK(not last.empty());
+  BOOST_CHECK(last.front().begin <= 32345 and last.back().end == first);
+}
+
+BOOST_AUTO_TEST_CASE(merge_categorical) {
+  // the first values seen differ, so the codes do too
+  const std::vector<std::vector<int>> runs = {{10, 10, 20}, {30, 30}};
+  std::vector<std::pair<std::string, std::string>> inputs;
+  for (const auto& values : runs) {
+    inputs.emplace_back(
+        "merge_categorical_" + std::to_string(inputs.size()) + "_" + filename,
+        "test");
+    hdtree::Tree t = hdtree::Tree::save(inputs.back().first, "test");
+    auto& run = t.branch<hdtree::Categorical<int>>("run");
+    for (int value : values) {
+      *run = value;
+      t.save();
+    }
+  }
+
+  BOOST_CHECK_THROW(hdtree::merge(inputs, {"merged_categorical_" + filename,
+                                           "test"}),
+                    hdtree::HDTreeException);
+  BOOST_CHECK_THROW(hdtree::chain(inputs, {"chained_categorical_" + filename,
+                                           "test"}),
+                    hdtree::HDTreeException);
+
+  // a single tree is only copied
+  BOOST_CHECK(hdtree::merge({inputs.back()},
+                            {"merged_categorical_" + filename, "test"}) == 2);
+  hdtree::Tree t = hdtree::Tree::load("merged_categorical_" + filename, "test");
+  auto& run = t.get<hdtree::Categorical<int>>("run");
+  std::size_t n_wrong{0};
+  t.for_each([&]() {
+    if (*run != 30) n_wrong++;
+  });
+  BOOST_CHECK(n_wrong == 0);
+}
+
+BOOST_AUTO_TEST_CASE(chain) {
+  const std::vector<std::size_t> sizes = {16, 20000, 13};
+  std::vector<std::pair<std::string, std::string>> inputs;
+  std::size_t first{0};
+  for (std::size_t size : sizes) {
+    inputs.emplace_back("chain_" + std::to_string(first) + "_" + filename,
+                        "test");
+    hdtree::Tree t = hdtree::Tree::save(inputs.back().first, "test");
+    t.set_pack_bools(true);
+    t.set_zone_maps(true);
+    auto& i_entry = t.branch<long>("i_entry");
+    auto& hits = t.branch<std::vector<int>>("hits");
+    auto& even = t.branch<bool>("even");
+    auto& name = t.branch<std::string>("name");
+    for (std::size_t i{first}; i < first + size; ++i) {
+      *i_entry = i;
+      hits->assign(i % 4, int(i));
+      *even = (i % 2 == 0);
+      *name = std::to_string(i);
+      t.save();
+    }
+    first += size;
+  }
+
+  // the packed bools of the last input end partway through a byte
+  BOOST_CHECK_THROW(hdtree::chain({inputs.back(), inputs.front()},
+                                  {"chain_bad_" + filename, "test"}),
+                    hdtree::HDTreeException);
+  BOOST_CHECK(hdtree::chain(inputs, {"chain_" + filename, "test"}) == first);
+  hdtree::Tree t = hdtree::Tree::load("chain_" + filename, "test");
+  auto& i_entry = t.get<long>("i_entry");
+  auto& hits = t.get<std::vector<int>>("hits");
+  auto& even = t.get<bool>("even");
+  auto& name = t.get<std::string>("name");
+  std::size_t i{0}, n_wrong{0};
+  t.for_each([&]() {
+    if (*i_entry != long(i) or hits->size() != i % 4 or
+        (not hits->empty() and hits->front() != int(i)) or
+        *even != (i % 2 == 0) or *name != std::to_string(i)) {
+      n_wrong++;
+    }
+    ++i;
+  });
+  BOOST_CHECK(i == first);
+  BOOST_CHECK(n_wrong == 0);
+  BOOST_CHECK(not t.select("i_entry", hdtree::Interval::less(16)).empty());
+}
+
+BOOST_AUTO_TEST_CASE(passthrough) {
+  const std::size_t n{25013};
+  {
+    hdtree::Tree t = hdtree::Tree::save("passthrough_" + filename, "test");
+    t.set_zone_maps(true);
+    auto& i_entry = t.branch<long>("i_entry");
+    auto& hits = t.branch<std::vector<int>>("hits");
+    auto& even = t.branch<bool>("even");
+    auto& name = t.branch<std::string>("name");
+    auto& dropped = t.branch<double>("dropped");
+    for (std::size_t i{0}; i < n; ++i) {
+      *i_entry = i;
+      hits->assign(i % 4, int(i));
+      *even = (i % 2 == 0);
+      *name = std::to_string(i);
+      *dropped = 0.5 * i;
+      t.save();
+    }
+  }
+
+  BOOST_CHECK_THROW(hdtree::Tree::transform({"passthrough_" + filename, "test"},
+                                            {"bad_" + filename, "test"},
+                                            {"keep"}),
+                    hdtree::HDTreeException);
+
+  for (bool only_odd : {false, true}) {
+    std::string out = (only_odd ? "odd_" : "all_") + filename;
+    {
+      hdtree::Tree t = hdtree::Tree::transform(
+          {"passthrough_" + filename, "test"}, {out, "test"},
+          {"keep *", "drop drop*"});
+      auto& even = t.get<bool>("even");
+      auto& twice = t.branch<long>("twice");
+      for (std::size_t i{0}; i < n; ++i) {
+        t.load();
+        *twice = 2 * i;
+        if (not only_odd or not *even) t.save();
+      }
+      // the last entry was already saved
+      if (not only_odd) BOOST_CHECK_THROW(t.save(), hdtree::HDTreeException);
+    }
+
+    hdtree::Tree t = hdtree::Tree::load(out, "test");
+    BOOST_CHECK_THROW(t.get<double>("dropped"), hdtree::HDTreeException);
+    auto& i_entry = t.get<long>("i_entry");
+    auto& hits = t.get<std::vector<int>>("hits");
+    auto& name = t.get<std::string>("name");
+    auto& twice = t.get<long>("twice");
+    std::size_t i{only_odd ? 1u : 0u}, n_loaded{0}, n_wrong{0};
+    t.for_each([&]() {
+      if (*i_entry != long(i) or *twice != 2 * long(i) or
+          hits->size() != i % 4 or
+          (not hits->empty() and hits->back() != int(i)) or
+          *name != std::to_string(i)) {
+        n_wrong++;
+      }
+      i += only_odd ? 2 : 1;
+      n_loaded++;
+    });
+    BOOST_CHECK(n_loaded == (only_odd ? n / 2 : n));
+    BOOST_CHECK(n_wrong == 0);
+    // the zone maps are only copied if every entry is
+    BOOST_CHECK(t.select("i_entry", hdtree::Interval::less(0)).empty() ==
+                not only_odd);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(linked_passthrough,
+                     *boost::unit_test::depends_on("tree/passthrough")) {
+  BOOST_CHECK_THROW(hdtree::Tree::load("passthrough_" + filename, "test")
+                        .set_link_untouched(true),
+                    hdtree::HDTreeException);
+  {
+    // there is nothing to link without keep/drop rules
+    hdtree::Tree t = hdtree::Tree::transform(
+        {"passthrough_" + filename, "test"}, {"unlinked_" + filename, "test"});
+    BOOST_CHECK_THROW(t.set_link_untouched(true), hdtree::HDTreeException);
+  }
+
+  std::size_t n{0};
+  {
+    hdtree::Tree t = hdtree::Tree::transform(
+        {"passthrough_" + filename, "test"}, {"linked_" + filename, "test"},
+        {"keep *", "drop drop*"});
+    t.set_link_untouched(true);
+    auto& twice = t.branch<long>("twice");
+    t.for_each([&]() { *twice = 2 * long(n++); });
+    BOOST_CHECK_NO_THROW(t.close());
+  }
+
+  hdtree::Tree t = hdtree::Tree::load("linked_" + filename, "test");
+  BOOST_CHECK_THROW(t.get<double>("dropped"), hdtree::HDTreeException);
+  auto& i_entry = t.get<long>("i_entry");
+  auto& hits = t.get<std::vector<int>>("hits");
+  auto& even = t.get<bool>("even");
+  auto& name = t.get<std::string>("name");
+  auto& twice = t.get<long>("twice");
+  std::size_t i{0}, n_wrong{0};
+  t.for_each([&]() {
+    if (*i_entry != long(i) or *twice != 2 * long(i) or
+        hits->size() != i % 4 or
+        (not hits->empty() and hits->back() != int(i)) or
+        *even != (i % 2 == 0) or *name != std::to_string(i)) {
+      n_wrong++;
+    }
+    i++;
+  });
+  BOOST_CHECK(i == n);
+  BOOST_CHECK(n_wrong == 0);
+  // the zone maps are copied since every entry is
+  BOOST_CHECK(t.select("i_entry", hdtree::Interval::less(0)).empty());
+
+  // the linked tree only stores the new branch
+  BOOST_CHECK(4 * std::filesystem::file_size("linked_" + filename) <
+              std::filesystem::file_size("all_" + filename));
+}
+
+BOOST_AUTO_TEST_CASE(passthrough_read) {
+  static const std::vector<std::string> labels = {"ECal", "HCal", "Tracker"};
+  const std::size_t n{1000};
+  {
+    hdtree::Tree t = hdtree::Tree::save("passthrough_read_" + filename, "test");
+    auto& energy = t.branch<double>("energy");
+    auto& det = t.branch<hdtree::Categorical<std::string>>("detector");
+    auto& run = t.branch<hdtree::Categorical<int>>("run");
+    for (std::size_t i{0}; i < n; ++i) {
+      *energy = 0.5 * i;
+      *det = labels.at(i % labels.size());
+      *run = 1000 + i / 100;
+      t.save();
+    }
+  }
+
+  {
+    hdtree::Tree t = hdtree::Tree::transform(
+        {"passthrough_read_" + filename, "test"},
+        {"passthrough_odd_" + filename, "test"}, {"keep *"});
+    // only read, so it is still copied
+    auto& energy = t.get<double>("energy");
+    auto& calibrated = t.branch<double>("calibrated");
+    for (std::size_t i{0}; i < n; ++i) {
+      t.load();
+      *calibrated = 0.9 * *energy;
+      if (i % 2 == 1) t.save();
+    }
+    BOOST_CHECK_NO_THROW(t.close());
+    BOOST_CHECK_NO_THROW(t.close());
+  }
+
+  hdtree::Tree t = hdtree::Tree::load("passthrough_odd_" + filename, "test");
+  auto& energy = t.get<double>("energy");
+  auto& calibrated = t.get<double>("calibrated");
+  auto& det = t.get<hdtree::Categorical<std::string>>("detector");
+  auto& run = t.get<hdtree::Categorical<int>>("run");
+  BOOST_CHECK(det.dictionary()->size() == labels.size());
+  std::size_t i{1}, n_wrong{0};
+  t.for_each([&]() {
+    if (*energy != 0.5 * i or *calibrated != 0.9 * 0.5 * i or
+        det->value() != labels.at(i % labels.size()) or
+        *run != int(1000 + i / 100)) {
+      n_wrong++;
+    }
+    i += 2;
+  });
+  BOOST_CHECK(i == n + 1);
+  BOOST_CHECK(n_wrong == 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,79 @@
+/**
+ * @file chain.cxx
+ * Command line program for chaining many HDTrees into one without
+ * copying their entries
+ */
+
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "hdtree/Exception.h"
+#include "hdtree/Merge.h"
+
+/**
+ * print help for the chain program
+ *
+ * @param[in] program name of program that is being run
+ */
+void print_help(const std::string& program) {
+  std::cout
+      << "USAGE:\n"
+      << "  " << program << " [-h] [-t TREE] OUTPUT INPUT...\n"
+      << "\n"
+      << "  Chain the HDTrees in the INPUT files into one HDTree in the\n"
+      << "  OUTPUT file whose branches are virtual data sets reading from\n"
+      << "  the INPUT files, so the INPUT files need to stay where they\n"
+      << "  are. The OUTPUT file is overwritten.\n"
+      << "\n"
+      << "OPTIONS:\n"
+      << "  -h, --help : print this help and exit\n"
+      << "  -t, --tree : path to the tree in every file (default: tree)\n"
+      << "\n"
+      << "ARGUMENTS:\n"
+      << "  OUTPUT : file to write the chain to\n"
+      << "  INPUT  : files holding the HDTrees to chain in order\n"
+      << std::endl;
+}
+
+int main(int argc, char** argv) try {
+  std::string program{argv[0]}, tree{"tree"};
+  std::vector<std::string> positionals;
+  for (int i_arg{1}; i_arg < argc; ++i_arg) {
+    std::string arg{argv[i_arg]};
+    if (arg == "-h" or arg == "--help") {
+      print_help(program);
+      return 0;
+    } else if (arg == "-t" or arg == "--tree") {
+      if (i_arg + 1 >= argc) {
+        std::cerr << "ERROR: " << arg << " requires an argument."
+                  << std::endl;
+        return 1;
+      }
+      tree = argv[++i_arg];
+    } else {
+      positionals.emplace_back(arg);
+    }
+  }
+
+  if (positionals.size() < 2) {
+    print_help(program);
+    return 1;
+  }
+
+  std::vector<std::pair<std::string, std::string>> inputs;
+  for (auto it = positionals.begin() + 1; it != positionals.end(); ++it) {
+    inputs.emplace_back(*it, tree);
+  }
+  std::size_t entries = hdtree::chain(inputs, {positionals.front(), tree});
+  std::cout << "Chained " << entries << " entries from " << inputs.size()
+            << " trees into " << positionals.front() << std::endl;
+  return 0;
+} catch (const hdtree::HDTreeException& e) {
+  std::cerr << "ERROR " << e << std::endl;
+  return 1;
+} catch (const std::exception& e) {
+  std::cerr << "ERROR: " << e.what() << std::endl;
+  return 1;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file merge.cxx
+ * Command line program for concatenating many HDTrees into one
+ */
+
+/**
+ * @dir tools
+ * Command line programs installed along with the HDTree library.
+ */
+
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "hdtree/Exception.h"
+#include "hdtree/Merge.h"
+
+/**
+ * print help for the merge program
+ *
+ * @param[in] program name of program that is being run
+ */
+void print_help(const std::string& program) {
+  std::cout
+      << "USAGE:\n"
+      << "  " << program << " [-h] [-t TREE] [-j THREADS] OUTPUT INPUT...\n"
+      << "\n"
+      << "  Concatenate the entries of the HDTrees in the INPUT files into\n"
+      << "  one HDTree in the OUTPUT file. The OUTPUT file is overwritten.\n"
+      << "\n"
+      << "OPTIONS:\n"
+      << "  -h, --help    : print this help and exit\n"
+      << "  -t, --tree    : path to the tree in every file (default: tree)\n"
+      << "  -j, --threads : threads compressing chunks (default: one per "
+         "core)\n"
+      << "\n"
+      << "ARGUMENTS:\n"
+      << "  OUTPUT : file to write the merged HDTree to\n"
+      << "  INPUT  : files holding the HDTrees to merge in order\n"
+      << std::endl;
+}
+
+int main(int argc, char** argv) try {
+  std::string program{argv[0]}, tree{"tree"};
+  std::size_t n_threads{0};
+  std::vector<std::string> positionals;
+  for (int i_arg{1}; i_arg < argc; ++i_arg) {
+    std::string arg{argv[i_arg]};
+    if (arg == "-h" or arg == "--help") {
+      print_help(program);
+      return 0;
+    } else if (arg == "-t" or arg == "--tree" or arg == "-j" or
+               arg == "--threads") {
+      if (i_arg + 1 >= argc) {
+        std::cerr << "ERROR: " << arg << " requires an argument."
+                  << std::endl;
+        return 1;
+      }
+      std::string val{argv[++i_arg]};
+      if (arg == "-t" or arg == "--tree") {
+        tree = val;
+      } else {
+        n_threads = std::stoul(val);
+      }
+    } else {
+      positionals.emplace_back(arg);
+    }
+  }
+
+  if (positionals.size() < 2) {
+    print_help(program);
+    return 1;
+  }
+
+  std::vector<std::pair<std::string, std::string>> inputs;
+  for (auto it = positionals.begin() + 1; it != positionals.end(); ++it) {
+    inputs.emplace_back(*it, tree);
+  }
+  std::size_t entries =
+      hdtree::merge(inputs, {positionals.front(), tree}, n_threads);
+  std::cout << "Merged " << entries << " entries from " << inputs.size()
+            << " trees into " << positionals.front() << std::endl;
+  return 0;
+} catch (const hdtree::HDTreeException& e) {
+  std::cerr << "ERROR " << e << std::endl;
+  return 1;
+} catch (const std::exception& e) {
+  std::cerr << "ERROR: " << e.what() << std::endl;
+  return 1;
+}